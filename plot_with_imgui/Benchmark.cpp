@@ -0,0 +1,235 @@
+#include "Benchmark.h"
+#include "Dataset.h"
+#include "Parallel.h"
+#include "NumberParser.h"
+#include "BlockCompression.h"
+#include "../imgui/imgui.h"
+#include <chrono>
+#include <algorithm>
+#include <charconv>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+void Benchmark::Show(bool* open, const std::string& filename)
+{
+    if (!ImGui::Begin("Benchmark", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("File: %s", filename.empty() ? "(drop a file and select it)" : filename.c_str());
+    ImGui::BeginDisabled(filename.empty());
+    if (ImGui::Button("Run CSV load"))
+        RunLoad(filename);
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (ImGui::Button("Run number parsing"))
+        RunParse();
+    ImGui::SameLine();
+    if (ImGui::Button("Run block compression"))
+        RunCompression();
+
+    if (!_load.empty())
+    {
+        ImGui::SeparatorText(_loadFile.c_str());
+        if (ImGui::BeginTable("##Load", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Threads");
+            ImGui::TableSetupColumn("Time [ms]");
+            ImGui::TableSetupColumn("MB/s");
+            ImGui::TableSetupColumn("Speedup");
+            ImGui::TableHeadersRow();
+            for (auto& result : _load)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%u", result.threads);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", result.seconds * 1e3);
+                ImGui::TableNextColumn(); ImGui::Text("%.0f", _loadBytes / result.seconds / 1e6);
+                ImGui::TableNextColumn(); ImGui::Text("%.2fx", _load[0].seconds / result.seconds);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    if (!_parse.empty())
+    {
+        ImGui::SeparatorText("Number parsing");
+        if (ImGui::BeginTable("##Parse", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Cells");
+            ImGui::TableSetupColumn("Parser");
+            ImGui::TableSetupColumn("M values/s");
+            ImGui::TableSetupColumn("Speedup");
+            ImGui::TableSetupColumn("Wrong");
+            ImGui::TableHeadersRow();
+            const ParseTiming* baseline = nullptr;
+            for (auto& result : _parse)
+            {
+                if (!baseline || strcmp(baseline->data, result.data) != 0)
+                    baseline = &result;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(result.data);
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(result.method);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", result.valuesPerSecond / 1e6);
+                ImGui::TableNextColumn(); ImGui::Text("%.2fx", result.valuesPerSecond / baseline->valuesPerSecond);
+                ImGui::TableNextColumn(); ImGui::Text("%zu", result.mismatches);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    if (!_compression.empty())
+    {
+        // a pan at 60 FPS decodes at most the visible blocks every 16 ms
+        ImGui::SeparatorText("Block compression");
+        if (ImGui::BeginTable("##Compression", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Samples");
+            ImGui::TableSetupColumn("Ratio");
+            ImGui::TableSetupColumn("Compress [M values/s]");
+            ImGui::TableSetupColumn("Decode [M values/s]");
+            ImGui::TableHeadersRow();
+            for (auto& result : _compression)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(result.data);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f:1", result.ratio);
+                ImGui::TableNextColumn(); ImGui::Text("%.0f", result.compressPerSecond / 1e6);
+                ImGui::TableNextColumn(); ImGui::Text("%.0f", result.decodePerSecond / 1e6);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    ImGui::End();
+}
+
+void Benchmark::RunLoad(const std::string& filename)
+{
+    static const int Repeats = 3;
+
+    _loadFile = filename;
+    _load.clear();
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < WorkerCount(); threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(WorkerCount());
+
+    Dataset warmup; // bring the file into the page cache so every run measures parsing, not the disk
+    warmup.Load(filename, WorkerCount(), Dataset::LoadMode::Eager, false);
+    _loadBytes = warmup.Bytes();
+
+    for (unsigned threads : threadCounts)
+    {
+        double best = 1e30;
+        for (int i = 0; i < Repeats; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            Dataset data;
+            data.Load(filename, threads, Dataset::LoadMode::Eager, false);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        _load.push_back({ threads, best });
+    }
+}
+
+// One thread parses cells laid out as in a CSV file, each parser on the same cells; the first parser of
+// each kind of cells is the baseline, atof on a copy of the cell as the plots used to parse.
+void Benchmark::RunParse()
+{
+    static const size_t Cells = 1 << 20;
+    static const int Repeats = 3;
+
+    struct Kind
+    {
+        const char* name;
+        const char* format;
+        double scale;
+    };
+    static const Kind kinds[] = {
+        { "decimals", "%.3f", 1e3 },
+        { "scientific", "%.6e", 1e-3 },
+    };
+
+    _parse.clear();
+    std::mt19937_64 random(1);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    for (const Kind& kind : kinds)
+    {
+        std::string text;
+        std::vector<size_t> starts;
+        char cell[32];
+        for (size_t i = 0; i < Cells; i++)
+        {
+            snprintf(cell, sizeof(cell), kind.format, distribution(random) * kind.scale);
+            starts.push_back(text.size());
+            text += cell;
+            text += ',';
+        }
+        starts.push_back(text.size());
+
+        std::vector<double> expected(Cells), parsed(Cells);
+        for (size_t i = 0; i < Cells; i++)
+            std::from_chars(text.data() + starts[i], text.data() + starts[i + 1] - 1, expected[i]);
+
+        auto run = [&](const char* method, auto&& parse) {
+            double best = 1e30;
+            for (int repeat = 0; repeat < Repeats; repeat++)
+            {
+                auto start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < Cells; i++)
+                    parse(text.data() + starts[i], text.data() + starts[i + 1] - 1, parsed[i]);
+                best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            size_t mismatches = 0;
+            for (size_t i = 0; i < Cells; i++)
+                mismatches += memcmp(&parsed[i], &expected[i], sizeof(double)) != 0;
+            _parse.push_back({ kind.name, method, Cells / best, mismatches });
+        };
+        run("atof", [](const char* begin, const char* end, double& value) { value = atof(std::string(begin, end).c_str()); });
+        run("std::from_chars", [](const char* begin, const char* end, double& value) { std::from_chars(begin, end, value); });
+        run("ParseNumber", [](const char* begin, const char* end, double& value) { ParseNumber(begin, end, value); });
+    }
+}
+
+// One thread compresses generated channels and decodes every block of them again
+void Benchmark::RunCompression()
+{
+    static const size_t Size = 1 << 22;
+    static const int Repeats = 3;
+    static const double Pi = 3.14159265358979323846;
+
+    _compression.clear();
+    std::mt19937_64 random(1);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    auto run = [&](const char* name, auto&& generate) {
+        std::vector<double> values(Size);
+        for (size_t i = 0; i < Size; i++)
+            values[i] = generate(i);
+
+        double compress = 1e30, decode = 1e30;
+        std::vector<unsigned char> blob;
+        std::vector<double> decoded(BlockCompression::BlockSize);
+        for (int repeat = 0; repeat < Repeats; repeat++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            blob = BlockCompression::Compress(values.data(), Size);
+            compress = std::min(compress, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            start = std::chrono::steady_clock::now();
+            for (size_t block = 0; block < BlockCompression::Blocks(blob.data()); block++)
+                BlockCompression::Decode(blob.data(), block, decoded.data());
+            decode = std::min(decode, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        _compression.push_back({ name, Size * sizeof(double) / static_cast<double>(blob.size()), Size / compress, Size / decode });
+    };
+    run("16-bit ADC counts", [&](size_t i) { return std::round(2000 * std::sin(2 * Pi * i / 5000.0) + 20 * noise(random)); });
+    run("millivolts, 3 decimals", [&](size_t i) { return std::round(1e3 * (std::sin(2 * Pi * i / 5000.0) + 0.01 * noise(random))) / 1e3; });
+    run("timestamps at 1 kHz", [&](size_t i) { return 1.7e9 + i / 1e3; });
+    run("smooth doubles", [&](size_t i) { return std::sin(2 * Pi * i / 5000.0); });
+    run("noisy doubles", [&](size_t i) { return std::sin(2 * Pi * i / 5000.0) + 0.01 * noise(random); });
+}
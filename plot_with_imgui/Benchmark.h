@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <string>
+
+// Timing window for the load path, so changes to it can be measured on real files, and for number
+// parsing and block compression on generated data of the kinds our files hold.
+class Benchmark
+{
+public:
+	void Show(bool* open, const std::string& filename);
+
+private:
+	void RunLoad(const std::string& filename);
+	void RunParse();
+	void RunCompression();
+
+	struct LoadResult
+	{
+		unsigned threads;
+		double seconds;
+	};
+	std::string _loadFile;
+	size_t _loadBytes = 0;
+	std::vector<LoadResult> _load;
+
+	struct ParseTiming
+	{
+		const char* data;
+		const char* method;
+		double valuesPerSecond;
+		size_t mismatches;	// values that differ from the correctly rounded ones
+	};
+	std::vector<ParseTiming> _parse;
+
+	struct CompressionTiming
+	{
+		const char* data;
+		double ratio;	// of the size as double to the compressed size
+		double compressPerSecond;
+		double decodePerSecond;
+	};
+	std::vector<CompressionTiming> _compression;
+};
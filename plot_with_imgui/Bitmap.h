@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Packed bit sets, one bit per sample and 64 samples per word. Scans look at a word at a time: clear
+// words are skipped whole and runs of set bits are found with a bit scan, so a consumer can process
+// every run with a plain loop and no test per sample.
+namespace Bitmap
+{
+	const size_t WordBits = 64;
+
+	inline size_t Words(size_t bits) { return (bits + WordBits - 1) / WordBits; }
+	inline bool Test(const uint64_t* words, size_t i) { return (words[i / WordBits] >> (i % WordBits)) & 1; }
+	inline void Set(uint64_t* words, size_t i) { words[i / WordBits] |= uint64_t(1) << (i % WordBits); }
+	inline void Clear(uint64_t* words, size_t i) { words[i / WordBits] &= ~(uint64_t(1) << (i % WordBits)); }
+
+	// index of the lowest set bit; word must not be 0
+	inline int LowestBit(uint64_t word)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, word);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctzll(word);
+#endif
+	}
+
+	inline int PopCount(uint64_t word)
+	{
+#ifdef _MSC_VER
+		return static_cast<int>(__popcnt64(word));
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+
+	// set bits in [begin, end)
+	inline size_t Count(const uint64_t* words, size_t begin, size_t end)
+	{
+		if (begin >= end)
+			return 0;
+		const size_t first = begin / WordBits;
+		const size_t last = (end - 1) / WordBits;
+		const uint64_t head = ~uint64_t(0) << (begin % WordBits);
+		const uint64_t tail = ~uint64_t(0) >> (WordBits - 1 - (end - 1) % WordBits);
+		if (first == last)
+			return PopCount(words[first] & head & tail);
+		size_t count = PopCount(words[first] & head) + PopCount(words[last] & tail);
+		for (size_t word = first + 1; word < last; word++)
+			count += PopCount(words[word]);
+		return count;
+	}
+
+	// calls fn(first, last) for every run [first, last) of set bits inside [begin, end), in order
+	template <typename Fn>
+	void ForEachRun(const uint64_t* words, size_t begin, size_t end, Fn&& fn)
+	{
+		size_t i = begin;
+		while (i < end)
+		{
+			const uint64_t set = words[i / WordBits] >> (i % WordBits);
+			if (set == 0)
+			{
+				i = (i / WordBits + 1) * WordBits;
+				continue;
+			}
+			i += LowestBit(set);
+			if (i >= end)
+				break;
+
+			// the run goes on through whole words of ones and ends at the first clear bit
+			size_t j = i;
+			while (j < end)
+			{
+				const uint64_t clear = ~words[j / WordBits] >> (j % WordBits);
+				if (clear == 0)
+				{
+					j = (j / WordBits + 1) * WordBits;
+					continue;
+				}
+				j += LowestBit(clear);
+				break;
+			}
+			j = j < end ? j : end;
+			fn(i, j);
+			i = j;
+		}
+	}
+}
@@ -0,0 +1,380 @@
+#include "BlockCompression.h"
+#include "SampleStorage.h"
+#include "Bitmap.h"
+#include "Parallel.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace BlockCompression
+{
+    namespace
+    {
+        enum Codec : uint32_t
+        {
+            Delta,	// integers over divisor, differences bit-packed
+            Xor		// doubles, XOR with the one before
+        };
+
+        // Blob layout: Header, one Block per BlockSize samples, the bits of every block starting at a
+        // byte, then Padding zero bytes so the reader may always load eight bytes.
+        struct Header
+        {
+            uint64_t bytes;
+            uint64_t samples;
+            uint32_t codec;
+            uint32_t reserved;
+            double divisor;
+        };
+
+        struct Block
+        {
+            uint64_t offset;	// of its bits in the blob
+            double lo;
+            double hi;
+            int64_t first;		// Delta: the first integer; Xor: the bits of the first double
+            int64_t step;		// Delta: smallest difference, subtracted from the packed ones
+            uint32_t width;		// Delta: bits per packed difference
+            uint32_t reserved;
+        };
+
+        const size_t Padding = 8;
+        const uint32_t MaxWidth = 56;	// the widest field one unaligned load can read at any bit
+
+        const Header& HeaderOf(const void* blob) { return *static_cast<const Header*>(blob); }
+        const Block* BlocksOf(const void* blob) { return reinterpret_cast<const Block*>(static_cast<const Header*>(blob) + 1); }
+        size_t BlockCount(size_t samples) { return (samples + BlockSize - 1) / BlockSize; }
+
+        int LeadingZeros(uint64_t word)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, word);
+            return 63 - static_cast<int>(index);
+#else
+            return __builtin_clzll(word);
+#endif
+        }
+
+        // bits in order of writing from the lowest bit of every byte up
+        class BitWriter
+        {
+        public:
+            explicit BitWriter(std::vector<unsigned char>& out) : _out(out) {}
+
+            // at most MaxWidth bits
+            void Put(uint64_t value, int bits)
+            {
+                _bits |= value << _fill;
+                _fill += bits;
+                for (; _fill >= 8; _fill -= 8)
+                {
+                    _out.push_back(static_cast<unsigned char>(_bits));
+                    _bits >>= 8;
+                }
+            }
+            void PutWide(uint64_t value, int bits)
+            {
+                if (bits > 32)
+                {
+                    Put(value & 0xFFFFFFFFu, 32);
+                    Put(value >> 32, bits - 32);
+                }
+                else
+                    Put(value, bits);
+            }
+            // to the next byte
+            void Flush()
+            {
+                if (_fill > 0)
+                    _out.push_back(static_cast<unsigned char>(_bits));
+                _bits = 0;
+                _fill = 0;
+            }
+
+        private:
+            std::vector<unsigned char>& _out;
+            uint64_t _bits = 0;
+            int _fill = 0;
+        };
+
+        class BitReader
+        {
+        public:
+            explicit BitReader(const unsigned char* bytes) : _bytes(bytes) {}
+
+            // the next MaxWidth bits, without consuming them
+            uint64_t Peek() const
+            {
+                uint64_t word;
+                memcpy(&word, _bytes + (_pos >> 3), sizeof(word));
+                return word >> (_pos & 7);
+            }
+            void Skip(int bits) { _pos += bits; }
+            uint64_t GetWide(int bits)
+            {
+                if (bits <= static_cast<int>(MaxWidth))
+                {
+                    const uint64_t value = Peek() & (~uint64_t(0) >> (64 - bits));
+                    _pos += bits;
+                    return value;
+                }
+                const uint64_t low = Peek() & 0xFFFFFFFFu;
+                _pos += 32;
+                return low | GetWide(bits - 32) << 32;
+            }
+
+        private:
+            const unsigned char* _bytes;
+            size_t _pos = 0;
+        };
+
+        void EncodeDelta(const double* values, size_t count, double divisor, Block& block, std::vector<unsigned char>& out)
+        {
+            // a decimal value times its power of ten is an integer a double holds exactly, see DecimalScale
+            int64_t differences[BlockSize];
+            int64_t previous = std::llround(values[0] * divisor);
+            block.first = previous;
+            block.step = 0;
+            for (size_t i = 1; i < count; i++)
+            {
+                const int64_t n = std::llround(values[i] * divisor);
+                differences[i] = n - previous;
+                previous = n;
+                block.step = i == 1 ? differences[i] : std::min(block.step, differences[i]);
+            }
+            uint64_t widest = 0;
+            for (size_t i = 1; i < count; i++)
+                widest = std::max(widest, static_cast<uint64_t>(differences[i] - block.step));
+            block.width = widest == 0 ? 0 : 64 - LeadingZeros(widest);
+
+            BitWriter writer(out);
+            for (size_t i = 1; i < count && block.width > 0; i++)
+                writer.Put(static_cast<uint64_t>(differences[i] - block.step), block.width);
+            writer.Flush();
+        }
+
+        // Integer is true when divisor is 1, which saves the division
+        template <bool Integer>
+        void DecodeDelta(const unsigned char* bits, const Block& block, size_t count, double divisor, double* out)
+        {
+            auto value = [&](uint64_t n) {
+                const double integer = static_cast<double>(static_cast<int64_t>(n));
+                return Integer ? integer : integer / divisor;
+            };
+            uint64_t n = static_cast<uint64_t>(block.first); // unsigned, so wrapping around is defined
+            const uint64_t step = static_cast<uint64_t>(block.step);
+            out[0] = value(n);
+            if (block.width == 0)
+            {
+                for (size_t i = 1; i < count; i++)
+                {
+                    n += step;
+                    out[i] = value(n);
+                }
+                return;
+            }
+            const uint64_t mask = (uint64_t(1) << block.width) - 1;
+            size_t pos = 0;
+            for (size_t i = 1; i < count; i++, pos += block.width)
+            {
+                uint64_t word;
+                memcpy(&word, bits + (pos >> 3), sizeof(word));
+                n += step + ((word >> (pos & 7)) & mask);
+                out[i] = value(n);
+            }
+        }
+
+        uint64_t BitsOf(double value)
+        {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        double DoubleOf(uint64_t bits)
+        {
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // per value: 0 if it repeats the one before; 10 and the meaningful bits of the XOR if they fit the
+        // window of the last 11; otherwise 11, the leading zeros (5 bits), the meaningful bits less one
+        // (6 bits) and those bits
+        void EncodeXor(const double* values, size_t count, Block& block, std::vector<unsigned char>& out)
+        {
+            uint64_t previous = BitsOf(values[0]);
+            block.first = static_cast<int64_t>(previous);
+            int leading = -1; // no window yet
+            int trailing = 0;
+            BitWriter writer(out);
+            for (size_t i = 1; i < count; i++)
+            {
+                const uint64_t bits = BitsOf(values[i]);
+                const uint64_t x = bits ^ previous;
+                previous = bits;
+                if (x == 0)
+                {
+                    writer.Put(0, 1);
+                    continue;
+                }
+                const int lz = std::min(LeadingZeros(x), 31);
+                const int tz = Bitmap::LowestBit(x);
+                if (leading >= 0 && lz >= leading && tz >= trailing)
+                {
+                    writer.Put(1, 2); // 1 then 0
+                    writer.PutWide(x >> trailing, 64 - leading - trailing);
+                    continue;
+                }
+                leading = lz;
+                trailing = tz;
+                const int meaningful = 64 - lz - tz;
+                writer.Put(3 | static_cast<uint64_t>(lz) << 2 | static_cast<uint64_t>(meaningful - 1) << 7, 13);
+                writer.PutWide(x >> tz, meaningful);
+            }
+            writer.Flush();
+        }
+
+        void DecodeXor(const unsigned char* bits, const Block& block, size_t count, double* out)
+        {
+            BitReader reader(bits);
+            uint64_t value = static_cast<uint64_t>(block.first);
+            out[0] = DoubleOf(value);
+            int leading = 0;
+            int meaningful = 64;
+            for (size_t i = 1; i < count; i++)
+            {
+                const uint64_t head = reader.Peek();
+                if ((head & 1) == 0)
+                    reader.Skip(1);
+                else
+                {
+                    if ((head & 2) == 0)
+                        reader.Skip(2);
+                    else
+                    {
+                        leading = static_cast<int>(head >> 2 & 31);
+                        meaningful = static_cast<int>(head >> 7 & 63) + 1;
+                        reader.Skip(13);
+                    }
+                    value ^= reader.GetWide(meaningful) << (64 - leading - meaningful);
+                }
+                out[i] = DoubleOf(value);
+            }
+        }
+    }
+
+    std::vector<unsigned char> Compress(const double* values, size_t size)
+    {
+        Header header = {};
+        header.samples = size;
+        header.divisor = DecimalScale(values, size);
+        header.codec = header.divisor > 0 ? Delta : Xor;
+
+        // every task encodes a range of blocks into its own bits, which are put together behind the index
+        static const size_t TaskBlocks = 64;
+        std::vector<Block> blocks(BlockCount(size));
+        const size_t tasks = std::min<size_t>(WorkerCount(), (blocks.size() + TaskBlocks - 1) / TaskBlocks);
+        std::vector<std::vector<unsigned char>> bits(tasks);
+        ParallelFor(tasks, [&](size_t task) {
+            for (size_t b = blocks.size() * task / tasks; b < blocks.size() * (task + 1) / tasks; b++)
+            {
+                const double* first = values + b * BlockSize;
+                const size_t count = std::min(BlockSize, size - b * BlockSize);
+                Block& block = blocks[b];
+                block.offset = bits[task].size();
+                block.lo = std::numeric_limits<double>::infinity();
+                block.hi = -std::numeric_limits<double>::infinity();
+                for (size_t i = 0; i < count; i++)
+                {
+                    // NaN compares false and leaves both alone, as in MinMaxPyramid
+                    block.lo = first[i] < block.lo ? first[i] : block.lo;
+                    block.hi = first[i] > block.hi ? first[i] : block.hi;
+                }
+                if (header.codec == Delta)
+                    EncodeDelta(first, count, header.divisor, block, bits[task]);
+                else
+                    EncodeXor(first, count, block, bits[task]);
+            }
+            });
+
+        std::vector<unsigned char> out(sizeof(Header) + blocks.size() * sizeof(Block));
+        for (size_t task = 0; task < tasks; task++)
+        {
+            for (size_t b = blocks.size() * task / tasks; b < blocks.size() * (task + 1) / tasks; b++)
+                blocks[b].offset += out.size();
+            out.insert(out.end(), bits[task].begin(), bits[task].end());
+        }
+        out.resize(out.size() + Padding);
+        out.shrink_to_fit();
+        header.bytes = out.size();
+        memcpy(out.data(), &header, sizeof(header));
+        if (!blocks.empty())
+            memcpy(out.data() + sizeof(Header), blocks.data(), blocks.size() * sizeof(Block));
+        return out;
+    }
+
+    bool Check(const void* blob, size_t bytes, size_t samples)
+    {
+        if (bytes < sizeof(Header) + Padding)
+            return false;
+        const Header& header = HeaderOf(blob);
+        const size_t blocks = BlockCount(samples);
+        if (header.bytes != bytes || header.samples != samples || header.codec > Xor ||
+            (header.codec == Delta && !(header.divisor > 0 && std::isfinite(header.divisor))) ||
+            blocks > (bytes - sizeof(Header) - Padding) / sizeof(Block))
+            return false;
+        const size_t bitsStart = sizeof(Header) + blocks * sizeof(Block);
+        for (size_t b = 0; b < blocks; b++)
+        {
+            const Block& block = BlocksOf(blob)[b];
+            const size_t count = std::min(BlockSize, samples - b * BlockSize);
+            if (block.offset < bitsStart || block.offset > bytes - Padding)
+                return false;
+            if (header.codec == Delta && (block.width > MaxWidth || ((count - 1) * block.width + 7) / 8 > bytes - Padding - block.offset))
+                return false;
+        }
+        return true;
+    }
+
+    size_t Bytes(const void* blob)
+    {
+        return static_cast<size_t>(HeaderOf(blob).bytes);
+    }
+
+    size_t Blocks(const void* blob)
+    {
+        return BlockCount(static_cast<size_t>(HeaderOf(blob).samples));
+    }
+
+    void BlockMinMax(const void* blob, size_t block, double& lo, double& hi)
+    {
+        lo = BlocksOf(blob)[block].lo;
+        hi = BlocksOf(blob)[block].hi;
+    }
+
+    void Decode(const void* blob, size_t block, double* out)
+    {
+        const Header& header = HeaderOf(blob);
+        const Block& info = BlocksOf(blob)[block];
+        const unsigned char* bits = static_cast<const unsigned char*>(blob) + info.offset;
+        const size_t count = std::min(BlockSize, static_cast<size_t>(header.samples) - block * BlockSize);
+        if (header.codec == Delta && header.divisor == 1)
+            DecodeDelta<true>(bits, info, count, header.divisor, out);
+        else if (header.codec == Delta)
+            DecodeDelta<false>(bits, info, count, header.divisor, out);
+        else
+            DecodeXor(bits, info, count, out);
+    }
+
+    const double* Decoded(const void* blob, uint64_t key, size_t block)
+    {
+        return DecodedBlocks::Get(key, block, [&](std::vector<double>& values) {
+            values.resize(BlockSize);
+            Decode(blob, block, values.data());
+            return values.data();
+            });
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "ThreadBlockCache.h"
+
+// Lossless compression of a column's samples in blocks of BlockSize, for keeping many long recordings
+// in memory at once. A column whose values are all integers over a power of ten (ADC counts, values
+// with fixed decimals) stores per block the differences between successive integers, bit-packed at the
+// width of the largest one after subtracting the smallest. Other columns store the XOR of every double
+// with the one before, as Gorilla does, which leaves few bits for slowly changing signals.
+// Every block decodes on its own and carries the min and max of its values, so a reader decodes only
+// the blocks it looks at. The whole column is one blob, which the cache stores and maps as it is.
+namespace BlockCompression
+{
+	const int BlockShift = 9;
+	const size_t BlockSize = size_t(1) << BlockShift;	// small enough that a pan decodes little more than it draws
+
+	std::vector<unsigned char> Compress(const double* values, size_t size);
+	// false unless the bytes hold a blob of that many samples with its blocks inside it; the contents
+	// of the blocks are not checked, the cache has a checksum for them
+	bool Check(const void* blob, size_t bytes, size_t samples);
+	size_t Bytes(const void* blob);
+	size_t Blocks(const void* blob);
+	// of the values of a block, +inf and -inf if they are all NaN
+	void BlockMinMax(const void* blob, size_t block, double& lo, double& hi);
+	// the values of block into out, BlockSize of them or the rest in the last block
+	void Decode(const void* blob, size_t block, double* out);
+
+	// Decoded blocks are kept in a ThreadBlockCache, so a reader decodes every block once while it stays
+	// there. key tells the blobs apart in the cache; ColumnBuffer passes its Version(), which no other
+	// contents ever get.
+	typedef ThreadBlockCache<std::vector<double>> DecodedBlocks;
+	const double* Decoded(const void* blob, uint64_t key, size_t block);
+
+	inline double At(const void* blob, uint64_t key, size_t i)
+	{
+		const double* values = DecodedBlocks::Last(key, i / BlockSize);
+		return (values ? values : Decoded(blob, key, i / BlockSize))[i % BlockSize];
+	}
+}
@@ -0,0 +1,314 @@
+#include "ColumnBuffer.h"
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+ColumnBuffer::ColumnBuffer(std::vector<double>&& values, ColumnType type)
+    : ColumnBuffer(std::move(values), type, std::vector<uint64_t>())
+{
+    SetGaps(FindGaps(Samples<double>{ _data, 0, 1 }, _size), _size);
+}
+
+ColumnBuffer::ColumnBuffer(const void* data, size_t size, const SampleFormat& format, std::shared_ptr<const void> owner, ColumnType type,
+    MinMaxPyramid&& pyramid, bool monotonic, size_t gaps)
+    : _owner(std::move(owner)), _data(format.type == StorageType::Double ? static_cast<const double*>(data) : nullptr),
+    _narrow(format.type == StorageType::Double ? nullptr : data), _format(format), _size(size), _type(type), _version(NextVersion()),
+    _pyramid(std::move(pyramid)), _sorted(monotonic ? size : 0), _descent(monotonic ? 0 : size)
+{
+    if (format.type == StorageType::Paged)
+        _gaps = gaps;
+    else if (gaps > 0)
+        SetGaps(VisitStorage([&](const auto& samples) { return FindGaps(samples, _size); }), _size);
+}
+
+// the last sample with a value in storage[begin, end), NaN if none
+template <typename S>
+static double LastValid(const S& storage, size_t begin, size_t end)
+{
+    while (end > begin)
+    {
+        const double v = storage[--end];
+        if (v == v)
+            return v;
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+// gaps are stepped over: every sample with a value is compared with the last one with a value before it
+size_t ColumnBuffer::LastDescent(size_t begin, size_t end) const
+{
+    return VisitStorage([&](const auto& storage) -> size_t {
+        double next = std::numeric_limits<double>::quiet_NaN();
+        size_t after = 0;
+        for (size_t i = end; i > begin; i--)
+        {
+            const double v = storage[i - 1];
+            if (v != v)
+                continue;
+            if (next < v)
+                return after;
+            next = v;
+            after = i - 1;
+        }
+        return next < LastValid(storage, _start, begin) ? after : 0;
+        });
+}
+
+size_t ColumnBuffer::SortedUntil(size_t from) const
+{
+    return VisitStorage([&](const auto& storage) {
+        size_t i = std::max<size_t>(from, 1);
+        double last = LastValid(storage, 0, std::min(i, _size));
+        for (; i < _size; i++)
+        {
+            const double v = storage[i];
+            if (v < last)
+                break;
+            if (v == v)
+                last = v;
+        }
+        return std::min(i, _size);
+        });
+}
+
+template <typename S>
+std::vector<uint64_t> ColumnBuffer::FindGaps(const S& samples, size_t size)
+{
+    std::vector<uint64_t> valid;
+    for (size_t word = 0; word < Bitmap::Words(size); word++)
+    {
+        const size_t first = word * Bitmap::WordBits;
+        const size_t last = std::min(size, first + Bitmap::WordBits);
+        uint64_t bits = 0;
+        for (size_t i = first; i < last; i++)
+        {
+            const double v = samples[i];
+            bits |= uint64_t(v == v) << (i - first); // false for NaN only
+        }
+        if (bits != ~uint64_t(0) >> (Bitmap::WordBits - (last - first)) && valid.empty())
+            valid.assign(Bitmap::Words(size), ~uint64_t(0));
+        if (!valid.empty())
+            valid[word] = bits | (~uint64_t(0) << 1 << (last - first - 1)); // the bits past the end stay set
+    }
+    return valid;
+}
+
+void ColumnBuffer::SetGaps(std::vector<uint64_t>&& valid, size_t size)
+{
+    _valid = std::move(valid);
+    _gaps = _valid.empty() ? 0 : size - Bitmap::Count(_valid.data(), 0, size);
+}
+
+void ColumnBuffer::UpdateGaps(size_t from, size_t replaced, size_t end)
+{
+    if (!_valid.empty() && replaced > from)
+        _gaps -= (replaced - from) - Bitmap::Count(_valid.data(), from, replaced);
+    VisitStorage([&](const auto& storage) {
+        if (_valid.empty())
+        {
+            size_t i = from;
+            while (i < end && storage[i] == storage[i])
+                i++;
+            if (i == end)
+                return;
+            _valid.assign(Bitmap::Words(end), ~uint64_t(0));
+        }
+        _valid.resize(Bitmap::Words(end), ~uint64_t(0));
+        for (size_t i = from; i < end; i++)
+        {
+            if (storage[i] == storage[i])
+                Bitmap::Set(_valid.data(), i);
+            else
+            {
+                Bitmap::Clear(_valid.data(), i);
+                _gaps++;
+            }
+        }
+        for (size_t i = end; i < _valid.size() * Bitmap::WordBits; i++)
+            Bitmap::Set(_valid.data(), i); // the bits past the end stay set, also where replaced samples were
+        });
+    // e.g. the partial last row of a followed file that was completed
+    if (_gaps == 0)
+        std::vector<uint64_t>().swap(_valid);
+}
+
+void ColumnBuffer::Own()
+{
+    if (_format.type != StorageType::Double)
+    {
+        if (_narrow == _packed.data())
+            return;
+        const unsigned char* bytes = static_cast<const unsigned char*>(_narrow);
+        _packed.assign(bytes, bytes + Bytes());
+        _owner.reset();
+        _narrow = _packed.data();
+        return;
+    }
+    if (_data == _values.data() + _start)
+        return;
+    _values.assign(_data, _data + _size);
+    _owner.reset();
+    _data = _values.data();
+    _start = 0;
+}
+
+void ColumnBuffer::Store(const SampleFormat& format, bool exact)
+{
+    if (format == _format)
+        return;
+
+    std::vector<double> values;
+    if (_data == _values.data() && _values.size() == _size)
+        values = std::move(_values); // owned doubles without a scrolled window are taken as they are
+    else
+    {
+        values.resize(_size);
+        Visit([&](const auto& samples) {
+            for (size_t i = 0; i < _size; i++)
+                values[i] = samples[i];
+            });
+    }
+    if (format.type == StorageType::Double)
+    {
+        _values = std::move(values);
+        std::vector<unsigned char>().swap(_packed);
+        _data = _values.data();
+        _narrow = nullptr;
+    }
+    else
+    {
+        std::vector<unsigned char> packed;
+        if (format.type == StorageType::Compressed)
+            packed = BlockCompression::Compress(values.data(), _size);
+        else
+        {
+            packed.resize(_size * StorageBytes(format.type));
+            Encode(values.data(), _size, format, packed.data());
+        }
+        _packed = std::move(packed);
+        std::vector<double>().swap(_values);
+        _data = nullptr;
+        _narrow = _packed.data();
+    }
+    _owner.reset();
+    _format = format;
+    _version = NextVersion();
+    _appends.clear();
+
+    // the window of a scrolled buffer is now the whole storage
+    if (_start > 0)
+    {
+        exact = false;
+        _start = 0;
+    }
+    if (!exact || _pyramid.Shift() != PyramidShift(format.type))
+    {
+        _pyramid = MinMaxPyramid(PyramidShift(format.type));
+        VisitStorage([&](const auto& samples) { _pyramid.Build(samples, _size); });
+    }
+    if (!exact)
+    {
+        _sorted = SortedUntil(0);
+        _descent = LastDescent(0, _size);
+        SetGaps(VisitStorage([&](const auto& samples) { return FindGaps(samples, _size); }), _size);
+    }
+}
+
+size_t ColumnBuffer::UnchangedUntil(uint64_t version) const
+{
+    if (version == _version)
+        return _size;
+    size_t unchanged = _size;
+    for (auto append = _appends.rbegin(); append != _appends.rend(); ++append)
+    {
+        unchanged = std::min(unchanged, append->from);
+        if (append->before == version)
+            return unchanged;
+    }
+    return 0;
+}
+
+int ColumnBuffer::PyramidShift(StorageType type)
+{
+    return type == StorageType::Compressed ? BlockCompression::BlockShift : MinMaxPyramid::BlockShift;
+}
+
+void ColumnBuffer::Append(size_t from, const double* values, size_t count)
+{
+    if (_format.type == StorageType::Compressed || _format.type == StorageType::Paged || !Fits(values, count, _format))
+        Store(SampleFormat(), true);
+    Own();
+    const size_t replaced = _size;
+    if (_appends.size() == KeptAppends)
+        _appends.erase(_appends.begin());
+    _appends.push_back({ _version, from });
+    if (_format.type == StorageType::Double)
+    {
+        _values.resize(from);
+        _values.insert(_values.end(), values, values + count);
+        _data = _values.data();
+        _size = _values.size();
+    }
+    else
+    {
+        const size_t bytes = StorageBytes(_format.type);
+        _packed.resize((from + count) * bytes);
+        Encode(values, count, _format, _packed.data() + from * bytes);
+        _narrow = _packed.data();
+        _size = from + count;
+    }
+    _version = NextVersion();
+    VisitStorage([&](const auto& samples) { _pyramid.Update(samples, from, _size); });
+    UpdateGaps(from, replaced, _size);
+
+    const size_t descent = LastDescent(from, _size);
+    if (descent > 0)
+        _descent = descent;
+    else if (_descent >= from)
+        _descent = _sorted >= from ? 0 : from - 1; // the replaced samples held the last descent; one before them remains if the prefix is unsorted
+    if (_sorted >= from)
+        _sorted = SortedUntil(from);
+}
+
+void ColumnBuffer::Scroll(const double* values, size_t count, size_t capacity, size_t slack)
+{
+    if (_format.type != StorageType::Double)
+        Store(SampleFormat(), true);
+    if (count > capacity)
+    {
+        values += count - capacity;
+        count = capacity;
+    }
+    Own();
+    const size_t minSlack = MinMaxPyramid::BlockSize;
+    _values.reserve(capacity + std::max(slack, minSlack));
+
+    size_t end = _start + _size;
+    size_t start = end - std::min(_size, capacity - count);
+    if (end + count > _values.capacity())
+    {
+        // move the window back to the front by whole blocks, so the bottom of the pyramid moves along
+        const size_t drop = start >> MinMaxPyramid::BlockShift << MinMaxPyramid::BlockShift;
+        memmove(_values.data(), _values.data() + drop, (end - drop) * sizeof(double));
+        _values.resize(end - drop);
+        _pyramid.Drop(_values.data(), drop, end - drop);
+        if (!_valid.empty())
+            SetGaps(FindGaps(Samples<double>{ _values.data(), 0, 1 }, _values.size()), _values.size());
+        _descent = _descent > drop ? _descent - drop : 0;
+        start -= drop;
+        end -= drop;
+    }
+    _values.insert(_values.end(), values, values + count); // within the reserved storage, the samples stay put
+    _start = start;
+    _data = _values.data() + _start;
+    _size = end + count - start;
+    _version = NextVersion();
+    _appends.clear();
+    _pyramid.Update(Samples<double>{ _values.data(), 0, 1 }, end, end + count);
+    UpdateGaps(end, end, end + count);
+
+    const size_t descent = LastDescent(std::max(end, start + 1), end + count); // not against a forgotten sample
+    if (descent > 0)
+        _descent = descent;
+    _sorted = 0;
+}
@@ -0,0 +1,211 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include "MinMaxPyramid.h"
+#include "Bitmap.h"
+
+// Time columns hold seconds since 1970-01-01 UTC, the unit of ImPlot's time axis.
+enum class ColumnType
+{
+	Number,
+	Time
+};
+
+// Samples of one channel. The Dataset creates them, every plot, histogram or other view of the
+// channel holds a reference to the same buffer instead of a copy. The min/max pyramid of the
+// samples is built along with the buffer.
+// The samples are either owned by the buffer or live in memory owned by someone else (a mapped
+// cache file), which the buffer keeps alive.
+// Samples never change once written, except that the Dataset of a followed file appends to the end,
+// a live source scrolls its buffers and the user changes the storage type (on the UI thread, between
+// frames). Views cache their results by Version(), which every change of the samples changes.
+// A sample without a value (a cell that held no number) is NaN. A column with such gaps also has a
+// validity bitmap, so the code that must skip them finds them a word at a time; a column without gaps
+// has none and its consumers take their plain paths.
+// The samples are stored as double, in one of the narrow formats of SampleStorage.h, compressed
+// (BlockCompression.h) or on disk (PageFile.h). Code that reads many samples goes through Visit(), which
+// hands it a view of the stored type. Paged columns never change, have no validity bitmap (their gaps
+// are NaN, of which only the number is known) and a pyramid of coarse blocks.
+class ColumnBuffer
+{
+public:
+	explicit ColumnBuffer(std::vector<double>&& values, ColumnType type = ColumnType::Number);
+	// with the validity bitmap found while the samples were written: a bit per sample, set for those
+	// that hold a value; empty if all of them do
+	ColumnBuffer(std::vector<double>&& values, ColumnType type, std::vector<uint64_t>&& valid)
+		: _values(std::move(values)), _data(_values.data()), _size(_values.size()), _type(type), _version(NextVersion())
+	{
+		SetGaps(std::move(valid), _size);
+		_pyramid.Build(Samples<double>{ _data, 0, 1 }, _size);
+		_sorted = SortedUntil(0);
+		_descent = LastDescent(0, _size);
+	}
+	// samples of that format in memory kept alive by owner, with the pyramid and order already known.
+	// gaps is the number of samples without a value; above 0 the validity bitmap is found from the samples,
+	// except for paged ones, which keep the number only
+	ColumnBuffer(const void* data, size_t size, const SampleFormat& format, std::shared_ptr<const void> owner, ColumnType type,
+		MinMaxPyramid&& pyramid, bool monotonic, size_t gaps);
+	ColumnBuffer(const ColumnBuffer&) = delete;
+	ColumnBuffer& operator=(const ColumnBuffer&) = delete;
+
+	// replaces the samples from index from on (at most Size()) with values; the pyramid and the order are
+	// updated for the new samples only. Samples living in someone else's memory are copied on the first append.
+	// A narrow format is kept while it holds the new samples exactly, otherwise the column becomes double,
+	// as a compressed or paged one always does.
+	void Append(size_t from, const double* values, size_t count);
+	// Appends values and forgets the oldest samples beyond capacity, like a scrolling chart. The window
+	// slides through storage of capacity + slack samples and is moved back to its front once per slack
+	// samples; buffers scrolled together can be given different slacks so they do not all move in the same frame.
+	// Scrolling buffers hold doubles.
+	void Scroll(const double* values, size_t count, size_t capacity, size_t slack);
+	// stores the samples in format from now on; exact tells that format gives every sample back unchanged
+	// (ChooseFormat), so the pyramid and the order stay
+	void Store(const SampleFormat& format, bool exact);
+	// the samples [0, n) are those the buffer held at version: n is Size() for the current version and the
+	// smallest from of the Append calls since for a version at most KeptAppends appends back, otherwise 0
+	size_t UnchangedUntil(uint64_t version) const;
+	static const size_t KeptAppends = 8;
+
+	// the samples as doubles, null if they are stored in a narrow format
+	const double* Data() const { return _data; }
+	// the stored samples, Bytes() of them in Format()
+	const void* Raw() const { return _data ? static_cast<const void*>(_data) : _narrow; }
+	const SampleFormat& Format() const { return _format; }
+	SampleReader Reader() const { return { Raw(), _format, _version }; }
+	// calls fn with a Samples<T> (or CompressedSamples, PagedSamples) view of the samples in their stored type and
+	// returns what it returns. Views that read a column against its X take such views of both, the X an
+	// IndexSamples when there is no X column.
+	template <typename Fn>
+	decltype(auto) Visit(Fn&& fn) const
+	{
+		switch (_format.type)
+		{
+		case StorageType::Float: return fn(Samples<float>{ static_cast<const float*>(_narrow), 0, 1 });
+		case StorageType::Int32: return fn(Samples<int32_t>{ static_cast<const int32_t*>(_narrow), _format.offset, _format.divisor });
+		case StorageType::Int16: return fn(Samples<int16_t>{ static_cast<const int16_t*>(_narrow), _format.offset, _format.divisor });
+		case StorageType::Compressed: return fn(CompressedSamples{ _narrow, _version });
+		case StorageType::Paged: return fn(PagedSamples{ static_cast<const PagedColumn*>(_narrow) });
+		default: return fn(Samples<double>{ _data, 0, 1 });
+		}
+	}
+	size_t Size() const { return _size; }
+	double operator[](size_t i) const { return Reader()[i]; }
+	ColumnType Type() const { return _type; }
+	// indexed from the front of the storage, the samples start _start into it; use MinMax() for sample ranges
+	const MinMaxPyramid& Pyramid() const { return _pyramid; }
+	// the pyramid block size of a storage type: compressed columns are summarized per compression block,
+	// as 32-sample blocks would take about as much room as the compressed samples (paged columns bring
+	// their pyramid along)
+	static int PyramidShift(StorageType type);
+	// min and max of the samples [begin, end)
+	void MinMax(size_t begin, size_t end, double& lo, double& hi) const { _pyramid.Query(StorageReader(), _start + begin, _start + end, lo, hi); }
+	// nearest sample to (x, y) in pixels, see MinMaxPyramid::Nearest; xs holds the X of every sample,
+	// null for the sample index, and must be Monotonic() (ScatterIndex searches against any other X)
+	size_t Nearest(const ColumnBuffer* xs, double x, double y, double sx, double sy, double& dist2) const;
+
+	// true when the samples with a value never decrease, so the column can serve as X and be searched with
+	// binary search, which steps over the gaps (see LowerBoundOf)
+	bool Monotonic() const { return _descent <= _start; }
+
+	// false when every sample holds a value
+	bool HasGaps() const { return !_valid.empty(); }
+	bool Valid(size_t i) const { return _valid.empty() || Bitmap::Test(_valid.data(), _start + i); }
+	// samples with a value in [begin, end); of a paged column only the count of all samples leaves out the gaps
+	size_t CountValid(size_t begin, size_t end) const
+	{
+		if (!_valid.empty())
+			return Bitmap::Count(_valid.data(), _start + begin, _start + end);
+		return end - begin - (begin == 0 && end == _size ? _gaps : 0);
+	}
+	// calls fn(first, last) for every run of samples with values in [begin, end); one call without gaps
+	template <typename Fn>
+	void ForEachValidRun(size_t begin, size_t end, Fn&& fn) const
+	{
+		if (_valid.empty())
+		{
+			if (begin < end)
+				fn(begin, end);
+			return;
+		}
+		Bitmap::ForEachRun(_valid.data(), _start + begin, _start + end, [&](size_t first, size_t last) { fn(first - _start, last - _start); });
+	}
+	// first sample >= x (LowerBound) or > x (UpperBound), Size() if none; the column must be Monotonic()
+	size_t LowerBound(double x) const { return Visit([&](const auto& samples) { return LowerBoundOf(samples, 0, _size, x); }); }
+	size_t UpperBound(double x) const { return Visit([&](const auto& samples) { return UpperBoundOf(samples, 0, _size, x); }); }
+	// unique for every buffer contents, so results computed from the samples can be cached by it
+	uint64_t Version() const { return _version; }
+
+	// memory held by the samples; paged ones hold none but their pages in the PageCache
+	size_t Bytes() const { return _format.type == StorageType::Compressed ? BlockCompression::Bytes(_narrow) : _size * StorageBytes(_format.type); }
+
+private:
+	static uint64_t NextVersion()
+	{
+		static std::atomic<uint64_t> version(0);
+		return ++version;
+	}
+	// like Visit, over the whole storage instead of the window (narrow formats never scroll)
+	template <typename Fn>
+	decltype(auto) VisitStorage(Fn&& fn) const
+	{
+		if (_format.type == StorageType::Double)
+			return fn(Samples<double>{ _data - _start, 0, 1 });
+		return Visit(fn);
+	}
+	SampleReader StorageReader() const { return { _data ? static_cast<const void*>(_data - _start) : _narrow, _format, _version }; }
+	// last i in [begin, end) of the storage with a sample smaller than the last sample with a value before it
+	// (from _start on), 0 if none
+	size_t LastDescent(size_t begin, size_t end) const;
+	// end of the sorted prefix of the storage, given that it reaches at least from - 1
+	size_t SortedUntil(size_t from) const;
+	// takes the samples into _values or _packed if they live in someone else's memory
+	void Own();
+	// the validity bitmap of samples[0, size), empty if none is NaN
+	template <typename S>
+	static std::vector<uint64_t> FindGaps(const S& samples, size_t size);
+	// takes the bitmap of the storage samples [0, size) and counts its gaps
+	void SetGaps(std::vector<uint64_t>&& valid, size_t size);
+	// brings the bitmap up to date for the storage samples [from, end) that were just written over the
+	// samples [from, replaced); drops it when no gap is left
+	void UpdateGaps(size_t from, size_t replaced, size_t end);
+
+	std::vector<double> _values;
+	std::vector<unsigned char> _packed;	// the samples of a narrow format, when owned
+	std::shared_ptr<const void> _owner;
+	const double* _data;				// null for a narrow format
+	const void* _narrow = nullptr;		// the samples of a narrow format, which never scroll
+	SampleFormat _format;
+	size_t _size;
+	size_t _start = 0;	// of _data in _values, when scrolling
+	ColumnType _type;
+	uint64_t _version;
+	MinMaxPyramid _pyramid;
+	size_t _sorted;		// length of the non-decreasing prefix of the storage (gaps left out), so an append only checks the new samples
+	size_t _descent;	// see LastDescent, the samples are sorted when it lies outside the window
+	std::vector<uint64_t> _valid;	// bit per sample of the storage, empty without gaps
+	size_t _gaps = 0;				// cleared bits of _valid, NaN samples of a paged column
+	struct Appended
+	{
+		uint64_t before;	// the version the append started from
+		size_t from;
+	};
+	std::vector<Appended> _appends;	// the last Append calls, oldest first; any other change clears them
+};
+
+inline size_t ColumnBuffer::Nearest(const ColumnBuffer* xs, double x, double y, double sx, double sy, double& dist2) const
+{
+	// gaps are NaN, which is never nearer than anything
+	const SampleReader xReader = xs ? xs->Reader() : SampleReader();
+	return _pyramid.Nearest(StorageReader(), xs ? &xReader : nullptr, _start, _start + _size, x, y, sx, sy, dist2) - _start;
+}
+
+// The handle plots and views hold. It is const for them only: the owner of a column (Dataset, LiveSource,
+// SharedSource) keeps a shared_ptr<ColumnBuffer> to the same buffer and appends to it, scrolls it or stores
+// it in another format on the UI thread between frames, so a holder must not take the samples as fixed
+// past the frame and caches by Version(). A thread that reads a column on its own needs one that cannot
+// change meanwhile: a paged column, or one the owner leaves alone until it is done (Dataset::CacheWritten).
+typedef std::shared_ptr<const ColumnBuffer> ColumnBufferPtr;
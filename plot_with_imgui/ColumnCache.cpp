@@ -0,0 +1,270 @@
+#include "ColumnCache.h"
+#include <Windows.h>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    const char Magic[8] = { 'P', 'W', 'I', 'C', 'A', 'C', 'H', 'E' };
+    const uint32_t Version = 7;
+    const size_t KeySampleBytes = 64 * 1024;
+
+    size_t Align(uint64_t offset) { return static_cast<size_t>((offset + sizeof(double) - 1) / sizeof(double) * sizeof(double)); }
+}
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (size * 0xC2B2AE3D27D4EB4Full);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        h ^= word * 0x87C37B91114253D5ull;
+        h = ((h << 31) | (h >> 33)) * 0x4CF5AD432745937Full;
+    }
+    for (; i < size; i++)
+        h = (h ^ bytes[i]) * 0x100000001B3ull;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+// File layout: FileHeader, one Entry per column, the column names, then per column its samples and
+// its pyramid, 8-byte aligned. checksum covers the header (with checksum = 0), the entries and the names.
+struct ColumnCache::FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t csvSize;
+    uint64_t csvWriteTime;
+    uint64_t csvHash;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t indexBytes;	// header, entries and names
+    uint64_t checksum;
+};
+
+struct ColumnCache::Entry
+{
+    uint64_t nameOffset;
+    uint64_t nameLength;
+    uint64_t dataOffset;
+    uint64_t dataBytes;
+    uint64_t pyramidOffset;
+    uint64_t pyramidCount;	// doubles
+    uint64_t checksum;		// of the samples and the pyramid
+    uint32_t type;
+    uint32_t monotonic;
+    uint64_t empty;			// ParseIssues
+    uint64_t invalid;
+    uint64_t firstInvalid;
+    uint32_t gaps;			// some samples are NaN, the validity bitmap is found again on load
+    uint32_t storage;		// StorageType of the samples
+    double offset;			// SampleFormat of integer samples
+    double divisor;
+};
+
+bool CacheKey::Read(const std::string& filename, CacheKey& key)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+        return false;
+
+    key.size = file.Size();
+    key.writeTime = file.WriteTime();
+    const size_t head = std::min(file.Size(), KeySampleBytes);
+    const size_t tail = std::min(file.Size() - head, KeySampleBytes);
+    key.hash = HashBytes(file.Data(), head);
+    key.hash = HashBytes(file.Data() + file.Size() - tail, tail, key.hash);
+    return true;
+}
+
+bool ColumnCache::Open(const std::string& filename, const CacheKey& key)
+{
+    Close();
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(PathFor(filename)) || file->Size() < sizeof(FileHeader))
+        return false;
+
+    const char* data = file->Data();
+    const size_t size = file->Size();
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+    if (memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != Version ||
+        header->csvSize != key.size || header->csvWriteTime != key.writeTime || header->csvHash != key.hash)
+        return false;
+    if (header->indexBytes < sizeof(FileHeader) || header->indexBytes > size || header->columns > (header->indexBytes - sizeof(FileHeader)) / sizeof(Entry))
+        return false;
+
+    FileHeader copy = *header;
+    copy.checksum = 0;
+    const size_t entryBytes = static_cast<size_t>(header->columns) * sizeof(Entry);
+    const size_t namesOffset = sizeof(FileHeader) + entryBytes;
+    const uint64_t checksum = HashBytes(data + namesOffset, static_cast<size_t>(header->indexBytes) - namesOffset,
+        HashBytes(data + sizeof(FileHeader), entryBytes, HashBytes(&copy, sizeof(copy))));
+    if (checksum != header->checksum)
+        return false;
+
+    // the index is intact, but a stale writer could still have left offsets outside the file
+    const Entry* entries = reinterpret_cast<const Entry*>(data + sizeof(FileHeader));
+    for (uint64_t col = 0; col < header->columns; col++)
+    {
+        const Entry& entry = entries[col];
+        const StorageType storage = static_cast<StorageType>(entry.storage);
+        if (entry.storage > static_cast<uint32_t>(StorageType::Compressed) ||
+            (storage != StorageType::Compressed && (entry.dataBytes % StorageBytes(storage) != 0 || entry.dataBytes / StorageBytes(storage) != header->rows)))
+            return false;
+        if (entry.nameOffset > header->indexBytes || entry.nameLength > header->indexBytes - entry.nameOffset ||
+            entry.dataOffset % sizeof(double) != 0 || entry.dataOffset > size || entry.dataBytes > size - entry.dataOffset ||
+            entry.pyramidOffset % sizeof(double) != 0 || entry.pyramidOffset > size || entry.pyramidCount > (size - entry.pyramidOffset) / sizeof(double))
+            return false;
+    }
+
+    _file = std::move(file);
+    _header = header;
+    _entries = entries;
+    return true;
+}
+
+void ColumnCache::Close()
+{
+    _file.reset(); // columns handed out keep the mapping alive
+    _header = nullptr;
+    _entries = nullptr;
+}
+
+size_t ColumnCache::Rows() const
+{
+    return static_cast<size_t>(_header->rows);
+}
+
+size_t ColumnCache::Columns() const
+{
+    return static_cast<size_t>(_header->columns);
+}
+
+std::string ColumnCache::Name(size_t col) const
+{
+    return std::string(_file->Data() + _entries[col].nameOffset, static_cast<size_t>(_entries[col].nameLength));
+}
+
+std::shared_ptr<ColumnBuffer> ColumnCache::Column(size_t col) const
+{
+    const Entry& entry = _entries[col];
+    const size_t rows = Rows();
+    SampleFormat format;
+    format.type = static_cast<StorageType>(entry.storage);
+    format.offset = entry.offset;
+    format.divisor = entry.divisor;
+    const void* samples = _file->Data() + entry.dataOffset;
+    const double* pyramid = reinterpret_cast<const double*>(_file->Data() + entry.pyramidOffset);
+    const size_t pyramidCount = static_cast<size_t>(entry.pyramidCount);
+    const size_t bytes = static_cast<size_t>(entry.dataBytes);
+    if (HashBytes(pyramid, pyramidCount * sizeof(double), HashBytes(samples, bytes)) != entry.checksum)
+        return nullptr;
+    if (format.type == StorageType::Compressed && !BlockCompression::Check(samples, bytes, rows))
+        return nullptr;
+
+    MinMaxPyramid restored(ColumnBuffer::PyramidShift(format.type));
+    if (!restored.Restore(pyramid, pyramidCount, rows))
+        return nullptr;
+    return std::make_shared<ColumnBuffer>(samples, rows, format, _file, static_cast<ColumnType>(entry.type),
+        std::move(restored), entry.monotonic != 0, entry.gaps);
+}
+
+ParseIssues ColumnCache::Issues(size_t col) const
+{
+    ParseIssues issues;
+    issues.empty = _entries[col].empty;
+    issues.invalid = _entries[col].invalid;
+    issues.firstInvalid = _entries[col].firstInvalid;
+    return issues;
+}
+
+bool ColumnCache::Write(const std::string& filename, const CacheKey& key, const std::vector<std::string>& header,
+    const std::vector<ColumnBufferPtr>& columns, const std::vector<ParseIssues>& issues)
+{
+    const size_t rows = columns.empty() ? 0 : columns[0]->Size();
+
+    FileHeader fileHeader = {};
+    memcpy(fileHeader.magic, Magic, sizeof(Magic));
+    fileHeader.version = Version;
+    fileHeader.csvSize = key.size;
+    fileHeader.csvWriteTime = key.writeTime;
+    fileHeader.csvHash = key.hash;
+    fileHeader.rows = rows;
+    fileHeader.columns = columns.size();
+
+    // lay out the index, then the columns behind it
+    std::vector<Entry> entries(columns.size());
+    std::vector<std::vector<double>> pyramids(columns.size());
+    std::string names;
+    uint64_t offset = sizeof(FileHeader) + entries.size() * sizeof(Entry);
+    for (size_t col = 0; col < columns.size(); col++)
+    {
+        entries[col].nameOffset = offset + names.size();
+        entries[col].nameLength = header[col].size();
+        names += header[col];
+    }
+    fileHeader.indexBytes = offset + names.size();
+    offset = Align(fileHeader.indexBytes);
+    for (size_t col = 0; col < columns.size(); col++)
+    {
+        const ColumnBuffer& column = *columns[col];
+        pyramids[col] = column.Pyramid().Flatten();
+        Entry& entry = entries[col];
+        entry.dataOffset = offset;
+        entry.dataBytes = column.Bytes();
+        offset += column.Bytes();
+        entry.pyramidOffset = offset = Align(offset); // narrow samples end anywhere
+        entry.pyramidCount = pyramids[col].size();
+        offset += pyramids[col].size() * sizeof(double);
+        entry.checksum = HashBytes(pyramids[col].data(), pyramids[col].size() * sizeof(double), HashBytes(column.Raw(), column.Bytes()));
+        entry.type = static_cast<uint32_t>(column.Type());
+        entry.monotonic = column.Monotonic() ? 1 : 0;
+        entry.empty = issues[col].empty;
+        entry.invalid = issues[col].invalid;
+        entry.firstInvalid = issues[col].firstInvalid;
+        entry.gaps = column.HasGaps() ? 1 : 0;
+        entry.storage = static_cast<uint32_t>(column.Format().type);
+        entry.offset = column.Format().offset;
+        entry.divisor = column.Format().divisor;
+    }
+    fileHeader.checksum = HashBytes(names.data(), names.size(), HashBytes(entries.data(), entries.size() * sizeof(Entry), HashBytes(&fileHeader, sizeof(fileHeader))));
+
+    const std::string path = PathFor(filename);
+    static std::atomic<unsigned> writes(0); // two loads of the same file may write at the same time
+    const std::string temp = path + "." + std::to_string(++writes) + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+        out.write(names.data(), names.size());
+        static const char padding[sizeof(double)] = {};
+        out.write(padding, (sizeof(double) - fileHeader.indexBytes % sizeof(double)) % sizeof(double));
+        for (size_t col = 0; col < columns.size(); col++)
+        {
+            out.write(static_cast<const char*>(columns[col]->Raw()), columns[col]->Bytes());
+            out.write(padding, Align(columns[col]->Bytes()) - columns[col]->Bytes());
+            out.write(reinterpret_cast<const char*>(pyramids[col].data()), pyramids[col].size() * sizeof(double));
+        }
+        out.close();
+        if (!out)
+        {
+            DeleteFileA(temp.c_str());
+            return false;
+        }
+    }
+    // fails while a cache of the file is still mapped somewhere; the temporary file must not stay behind
+    if (!MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFileA(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "CsvFile.h"
+#include "ColumnBuffer.h"
+#include "NumberParser.h"
+
+// 64-bit hash of a byte range, eight bytes per step, fast enough to check columns at memory speed
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0x9E3779B97F4A7C15ull);
+
+// Identity of the contents of a CSV file; a cache is only used for a file with the key it was written for.
+struct CacheKey
+{
+	uint64_t size = 0;
+	uint64_t writeTime = 0;
+	uint64_t hash = 0;	// of the first and last 64 KiB, so the key is cheap to compute on any file size
+
+	bool operator==(const CacheKey& other) const { return size == other.size && writeTime == other.writeTime && hash == other.hash; }
+
+	// false if the file cannot be opened
+	static bool Read(const std::string& filename, CacheKey& key);
+};
+
+// Binary sidecar of a CSV file ("<file>.pwcache") holding what parsing it produced: the header and, per
+// column, the samples in their storage type (SampleStorage.h), the min/max pyramid, whether the samples are sorted and the cells that
+// held no number. Opening the cache maps it and checks the small index at its start; columns are handed out as views into the
+// mapping, so re-opening a file costs neither parsing nor copying. The samples of a column are checked
+// against their checksum the first time the column is used.
+class ColumnCache
+{
+public:
+	static std::string PathFor(const std::string& filename) { return filename + ".pwcache"; }
+
+	// false if there is no cache for this key, or it is stale or damaged
+	bool Open(const std::string& filename, const CacheKey& key);
+	void Close();
+	bool IsOpen() const { return _file != nullptr; }
+
+	size_t Rows() const;
+	size_t Columns() const;
+	std::string Name(size_t col) const;
+	// view of a column into the cache, nullptr if its contents are damaged
+	std::shared_ptr<ColumnBuffer> Column(size_t col) const;
+	ParseIssues Issues(size_t col) const;
+
+	// writes the cache of filename through a temporary file, so a reader never sees a partial cache
+	static bool Write(const std::string& filename, const CacheKey& key, const std::vector<std::string>& header,
+		const std::vector<ColumnBufferPtr>& columns, const std::vector<ParseIssues>& issues);
+
+private:
+	struct FileHeader;
+	struct Entry;
+
+	std::shared_ptr<MappedFile> _file;
+	const FileHeader* _header = nullptr;
+	const Entry* _entries = nullptr;
+};
@@ -0,0 +1,423 @@
+#include "CsvFile.h"
+#include "Parallel.h"
+#include <Windows.h>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : _file(other._file), _mapping(other._mapping), _data(other._data), _size(other._size)
+{
+    other._file = nullptr;
+    other._mapping = nullptr;
+    other._data = nullptr;
+    other._size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        std::swap(_file, other._file);
+        std::swap(_mapping, other._mapping);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+    }
+    return *this;
+}
+
+bool MappedFile::Open(const std::string& filename, uint64_t maxSize)
+{
+    Close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    _file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        Close();
+        return false;
+    }
+    _size = static_cast<size_t>(std::min<uint64_t>(size.QuadPart, maxSize));
+    if (_size == 0) // an empty file cannot be mapped, but it is a valid (empty) file
+        return true;
+
+    _mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (_mapping)
+        _data = static_cast<const char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, _size));
+    if (!_data)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+uint64_t MappedFile::WriteTime() const
+{
+    FILETIME time;
+    if (!_file || !GetFileTime(_file, nullptr, nullptr, &time))
+        return 0;
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+void MappedFile::Close()
+{
+    if (_data) { UnmapViewOfFile(_data); _data = nullptr; }
+    if (_mapping) { CloseHandle(_mapping); _mapping = nullptr; }
+    if (_file) { CloseHandle(_file); _file = nullptr; }
+    _size = 0;
+}
+
+std::string_view TrimQuotes(std::string_view str)
+{
+    size_t first = str.find_first_not_of('"');
+    if (first == std::string_view::npos)
+        return {}; // No non-quote characters found
+    size_t last = str.find_last_not_of('"');
+    return str.substr(first, last - first + 1);
+}
+
+bool CsvFile::Open(const std::string& filename, unsigned threads, size_t maxIndexedFields, LoadProgress* progress)
+{
+    if (!_file.Open(filename))
+        return false;
+    if (progress)
+        progress->total += _file.Size();
+
+    // count the header fields before deciding what to index
+    _indexFields = true;
+    if (maxIndexedFields != SIZE_MAX)
+    {
+        const char* data = _file.Data();
+        const size_t end = RowEnd(0);
+        bool quoted = false;
+        size_t fields = 1;
+        for (size_t pos = 0; pos < end; pos++)
+        {
+            if (data[pos] == '"')
+                quoted = !quoted;
+            else if (data[pos] == ',' && !quoted)
+                fields++;
+        }
+        _indexFields = fields <= maxIndexedFields;
+    }
+
+    BuildIndex(threads == 0 ? WorkerCount() : threads, progress);
+    if (progress && progress->Cancelled())
+    {
+        *this = CsvFile();
+        return false;
+    }
+    return Rows() > 0;
+}
+
+// end of the row starting at pos, before its line break
+size_t CsvFile::RowEnd(size_t pos) const
+{
+    const char* data = _file.Data();
+    const size_t size = _file.Size();
+    bool quoted = false;
+    for (; pos < size; pos++)
+    {
+        if (data[pos] == '"')
+            quoted = !quoted;
+        else if (data[pos] == '\n' && !quoted)
+            break;
+    }
+    return pos > 0 && data[pos - 1] == '\r' ? pos - 1 : pos;
+}
+
+void CsvFile::BuildIndex(unsigned threads, LoadProgress* progress)
+{
+    static const size_t MinChunkBytes = 1 << 20;
+
+    const char* data = _file.Data();
+    const size_t size = _file.Size();
+    size_t start = 0;
+    if (size >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') // UTF-8 BOM
+        start = 3;
+    if (progress)
+        progress->done += start;
+
+    const size_t chunkCount = std::min<size_t>(threads, std::max<size_t>(1, (size - start) / MinChunkBytes));
+    std::vector<size_t> bounds(chunkCount + 1);
+    for (size_t i = 0; i <= chunkCount; i++)
+        bounds[i] = start + (size - start) * i / chunkCount;
+
+    // a chunk edge may fall inside a quoted field, so first find out which chunks start inside quotes
+    std::vector<char> oddQuotes(chunkCount, 0);
+    if (chunkCount > 1)
+    {
+        ParallelFor(chunkCount, [&](size_t i) {
+            oddQuotes[i] = std::count(data + bounds[i], data + bounds[i + 1], '"') & 1;
+            });
+    }
+
+    std::vector<Chunk> chunks(chunkCount);
+    ParallelFor(chunkCount, [&](size_t i) {
+        bool quoted = false;
+        for (size_t j = 0; j < i; j++)
+            quoted ^= oddQuotes[j] != 0;
+
+        // the row running across the chunk edge belongs to the previous chunk
+        size_t pos = bounds[i];
+        if (i > 0 && (quoted || data[pos - 1] != '\n'))
+        {
+            for (; pos < size; pos++)
+            {
+                if (data[pos] == '"')
+                    quoted = !quoted;
+                else if (data[pos] == '\n' && !quoted)
+                {
+                    pos++;
+                    break;
+                }
+            }
+        }
+        const size_t reported = IndexRows(pos, bounds[i + 1], chunks[i], progress);
+        if (progress)
+            progress->done += bounds[i + 1] - bounds[i] - reported;
+        });
+
+    // stitch the chunks in file order
+    std::vector<size_t> rowBase(chunkCount + 1, 0), fieldBase(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        rowBase[i + 1] = rowBase[i] + chunks[i].rowOffsets.size();
+        fieldBase[i + 1] = fieldBase[i] + chunks[i].fieldOffsets.size();
+    }
+
+    if (chunkCount == 1)
+    {
+        _rowOffsets = std::move(chunks[0].rowOffsets);
+        _rowFields = std::move(chunks[0].rowFields);
+        _fieldOffsets = std::move(chunks[0].fieldOffsets);
+    }
+    else
+    {
+        _rowOffsets.resize(rowBase[chunkCount]);
+        _rowFields.resize(rowBase[chunkCount]);
+        _fieldOffsets.resize(fieldBase[chunkCount]);
+        ParallelFor(chunkCount, [&](size_t i) {
+            Chunk& chunk = chunks[i];
+            std::copy(chunk.rowOffsets.begin(), chunk.rowOffsets.end(), _rowOffsets.begin() + rowBase[i]);
+            std::copy(chunk.fieldOffsets.begin(), chunk.fieldOffsets.end(), _fieldOffsets.begin() + fieldBase[i]);
+            for (size_t row = 0; row < chunk.rowFields.size(); row++) // empty without a field index
+                _rowFields[rowBase[i] + row] = chunk.rowFields[row] + fieldBase[i];
+            Chunk().rowOffsets.swap(chunk.rowOffsets); // release the chunk while the others copy
+            Chunk().fieldOffsets.swap(chunk.fieldOffsets);
+            });
+    }
+    if (_indexFields)
+        _rowFields.push_back(_fieldOffsets.size());
+}
+
+// Indexes the rows starting in [begin, end); begin must be the start of a row. The last row is
+// followed past end to its line break. Returns the bytes added to progress->done on the way.
+size_t CsvFile::IndexRows(size_t begin, size_t end, Chunk& chunk, LoadProgress* progress) const
+{
+    static const size_t ReportBytes = 1 << 20;
+
+    const char* data = _file.Data();
+    const size_t size = _file.Size();
+    size_t pos = begin;
+    size_t reported = begin;
+
+    // a quote toggles the quoted state, so separators and line breaks inside quoted fields are kept in the field
+    bool quoted = false;
+    while (pos < end)
+    {
+        const size_t rowStart = pos;
+        const size_t firstField = chunk.fieldOffsets.size();
+        if (_indexFields)
+            chunk.fieldOffsets.push_back(0);
+        for (; pos < size; pos++)
+        {
+            const char c = data[pos];
+            if (c == '"')
+                quoted = !quoted;
+            else if (quoted)
+                continue;
+            else if (c == ',' && _indexFields)
+                chunk.fieldOffsets.push_back(static_cast<uint32_t>(pos + 1 - rowStart));
+            else if (c == '\n')
+                break;
+        }
+
+        size_t rowEnd = pos;
+        if (rowEnd > rowStart && data[rowEnd - 1] == '\r')
+            rowEnd--;
+        pos++; // skip the '\n'
+
+        if (rowEnd == rowStart) // blank line
+        {
+            chunk.fieldOffsets.resize(firstField);
+            continue;
+        }
+        chunk.rowOffsets.push_back(rowStart);
+        if (_indexFields)
+        {
+            chunk.fieldOffsets.push_back(static_cast<uint32_t>(rowEnd - rowStart + 1));
+            chunk.rowFields.push_back(firstField);
+        }
+
+        if (progress && pos < end && pos - reported >= ReportBytes)
+        {
+            progress->done += pos - reported;
+            reported = pos;
+            if (progress->Cancelled())
+                break;
+        }
+    }
+    return reported - begin;
+}
+
+size_t CsvFile::Fields(size_t row) const
+{
+    if (_indexFields)
+        return _rowFields[row + 1] - _rowFields[row] - 1;
+
+    const char* data = _file.Data();
+    const size_t end = RowEnd(_rowOffsets[row]);
+    bool quoted = false;
+    size_t fields = 1;
+    for (size_t pos = _rowOffsets[row]; pos < end; pos++)
+    {
+        if (data[pos] == '"')
+            quoted = !quoted;
+        else if (data[pos] == ',' && !quoted)
+            fields++;
+    }
+    return fields;
+}
+
+std::string_view CsvFile::Cell(size_t row, size_t field) const
+{
+    if (!_indexFields)
+    {
+        // skip field separators up to the start of the cell, then find its end
+        const char* data = _file.Data();
+        const size_t size = _file.Size();
+        size_t pos = _rowOffsets[row];
+        bool quoted = false;
+        for (size_t skipped = 0; skipped < field; pos++)
+        {
+            if (pos >= size || (data[pos] == '\n' && !quoted))
+                return {};
+            if (data[pos] == '"')
+                quoted = !quoted;
+            else if (data[pos] == ',' && !quoted)
+                skipped++;
+        }
+        size_t end = pos;
+        for (; end < size; end++)
+        {
+            if (data[end] == '"')
+                quoted = !quoted;
+            else if ((data[end] == ',' || data[end] == '\n') && !quoted)
+                break;
+        }
+        if (end > pos && data[end - 1] == '\r' && (end == size || data[end] == '\n'))
+            end--;
+        return TrimQuotes(std::string_view(data + pos, end - pos));
+    }
+
+    if (field >= Fields(row))
+        return {};
+
+    const char* rowData = _file.Data() + _rowOffsets[row];
+    const uint32_t* fields = _fieldOffsets.data() + _rowFields[row];
+    return TrimQuotes(std::string_view(rowData + fields[field], fields[field + 1] - 1 - fields[field]));
+}
+
+void CsvFile::Cells(size_t row, size_t count, std::string_view* cells) const
+{
+    if (_indexFields)
+    {
+        for (size_t field = 0; field < count; field++)
+            cells[field] = Cell(row, field);
+        return;
+    }
+
+    const char* data = _file.Data();
+    const size_t end = RowEnd(_rowOffsets[row]);
+    size_t start = _rowOffsets[row];
+    size_t field = 0;
+    bool quoted = false;
+    for (size_t pos = start; pos <= end && field < count; pos++)
+    {
+        if (pos < end && data[pos] == '"')
+            quoted = !quoted;
+        else if (pos == end || (data[pos] == ',' && !quoted))
+        {
+            cells[field++] = TrimQuotes(std::string_view(data + start, pos - start));
+            start = pos + 1;
+        }
+    }
+    for (; field < count; field++)
+        cells[field] = {};
+}
+
+size_t CsvFile::IndexBytes() const
+{
+    return _rowOffsets.size() * sizeof(uint64_t) + _rowFields.size() * sizeof(uint64_t) +
+        _fieldOffsets.size() * sizeof(uint32_t);
+}
+
+size_t CsvFile::OpenWindow(const std::string& filename, size_t rows, uint64_t from, bool completeRows, uint64_t size)
+{
+    *this = CsvFile();
+    if (!_file.Open(filename, size) || from > _file.Size())
+        return 0;
+    _indexFields = false;
+    _completeRows = completeRows;
+    const char* data = _file.Data();
+    _windowEnd = from;
+    if (from == 0 && _file.Size() >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') // UTF-8 BOM
+        _windowEnd = 3;
+    return NextWindow(rows);
+}
+
+size_t CsvFile::NextWindow(size_t rows)
+{
+    const char* data = _file.Data();
+    const size_t size = _file.Size();
+    _rowOffsets.clear();
+    size_t pos = static_cast<size_t>(_windowEnd);
+    while (pos < size && _rowOffsets.size() < rows)
+    {
+        // the line break ending the row is the first one after an even number of quotes
+        const size_t rowStart = pos;
+        bool quoted = false;
+        for (;;)
+        {
+            const char* found = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+            const size_t end = found ? found - data : size;
+            quoted ^= (std::count(data + pos, data + end, '"') & 1) != 0;
+            pos = end;
+            if (!quoted || pos == size)
+                break;
+            pos++;
+        }
+        if (pos == size && _completeRows)
+        {
+            pos = rowStart;
+            break;
+        }
+
+        size_t rowEnd = pos;
+        if (rowEnd > rowStart && data[rowEnd - 1] == '\r')
+            rowEnd--;
+        pos = std::min(pos + 1, size); // past the '\n'
+        if (rowEnd > rowStart) // not a blank line
+            _rowOffsets.push_back(rowStart);
+    }
+    _windowEnd = pos;
+    return _rowOffsets.size();
+}
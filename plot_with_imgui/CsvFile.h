@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <climits>
+#include <atomic>
+
+// Shared between a load running on a worker thread and whoever watches it. done counts up to total
+// (bytes indexed plus bytes parsed); setting cancel makes the load stop early and fail.
+struct LoadProgress
+{
+	std::atomic<uint64_t> done{ 0 };
+	std::atomic<uint64_t> total{ 0 };
+	std::atomic<bool> cancel{ false };
+	std::atomic<bool> headerReady{ false };	// the dataset's header can be read while it goes on parsing
+
+	bool Cancelled() const { return cancel.load(std::memory_order_relaxed); }
+};
+
+// Read-only view of a whole file mapped into the address space.
+class MappedFile
+{
+public:
+	MappedFile() : _file(nullptr), _mapping(nullptr), _data(nullptr), _size(0) {}
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// maps at most the first maxSize bytes
+	bool Open(const std::string& filename, uint64_t maxSize = UINT64_MAX);
+	void Close();
+
+	const char* Data() const { return _data; }
+	size_t Size() const { return _size; }
+	// last write time of the file (FILETIME ticks)
+	uint64_t WriteTime() const;
+
+private:
+	void* _file;
+	void* _mapping;
+	const char* _data;
+	size_t _size;
+};
+
+// CSV file kept in its mapping. Loading makes one pass over the bytes and records where every row
+// and field starts; cells are handed out as views into the mapping, nothing is copied.
+// Large files are indexed in parallel: the bytes are cut into one chunk per thread, each chunk
+// indexes the rows that start inside it and the chunk indexes are stitched together in order.
+// Very wide files would need an entry per cell, so above a number of header fields only the row starts
+// are kept and a cell is found by scanning its row.
+class CsvFile
+{
+public:
+	// threads = 0 uses every core, 1 indexes on the calling thread; field starts are only indexed when
+	// the header has at most maxIndexedFields fields. Indexing adds the file size to progress->total and
+	// the bytes it has gone through to progress->done; it fails when progress->cancel is set.
+	bool Open(const std::string& filename, unsigned threads = 0, size_t maxIndexedFields = SIZE_MAX, LoadProgress* progress = nullptr);
+
+	size_t Rows() const { return _rowOffsets.size(); }
+	size_t Fields(size_t row) const;
+	// cell text with the surrounding quotes removed, empty if the row is shorter than field
+	std::string_view Cell(size_t row, size_t field) const;
+	// the first count cells of a row in one pass, as Cell() would return them
+	void Cells(size_t row, size_t count, std::string_view* cells) const;
+	bool FieldsIndexed() const { return _indexFields; }
+
+	size_t Bytes() const { return _file.Size(); }
+	size_t IndexBytes() const;
+
+	// For files too large to index at once: OpenWindow() maps the file and indexes only its first rows rows
+	// from the row starting at byte from, NextWindow() replaces them with the rows after them. Rows are
+	// numbered within the window; neither call indexes field starts. Both return the rows in the window,
+	// 0 once the file is done. With completeRows, a last row without a line break is left out, as the
+	// program writing the file may not be done with it; size reads the file as if it ended there.
+	size_t OpenWindow(const std::string& filename, size_t rows, uint64_t from = 0, bool completeRows = false, uint64_t size = UINT64_MAX);
+	size_t NextWindow(size_t rows);
+	// bytes of the file up to the end of the window
+	uint64_t WindowEnd() const { return _windowEnd; }
+
+private:
+	struct Chunk
+	{
+		std::vector<uint64_t> rowOffsets;
+		std::vector<uint64_t> rowFields;
+		std::vector<uint32_t> fieldOffsets;
+	};
+	void BuildIndex(unsigned threads, LoadProgress* progress);
+	size_t IndexRows(size_t begin, size_t end, Chunk& chunk, LoadProgress* progress) const;
+	size_t RowEnd(size_t pos) const;
+
+	MappedFile _file;
+	bool _indexFields = true;
+	bool _completeRows = false;
+	uint64_t _windowEnd = 0;
+	std::vector<uint64_t> _rowOffsets;		// byte offset of each row in the mapping
+	std::vector<uint64_t> _rowFields;		// first entry of each row in _fieldOffsets, plus one past the last row
+	std::vector<uint32_t> _fieldOffsets;	// field starts relative to the row, each row closed by (row length + 1)
+};
+
+std::string_view TrimQuotes(std::string_view str);
@@ -0,0 +1,506 @@
+#include "Dataset.h"
+#include "Parallel.h"
+#include "Timestamp.h"
+#include <Windows.h>
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+    // nothing but blanks, as ParseNumber sees them; an empty cell
+    bool IsBlank(std::string_view cell)
+    {
+        return cell.find_first_not_of(" \t\r") == std::string_view::npos;
+    }
+
+    // a column is a time column when its first non-empty cells (from row first on) all read as timestamps
+    ColumnType DetectType(const CsvFile& csv, size_t col, size_t first = 1)
+    {
+        static const int SampleRows = 16;
+
+        int samples = 0;
+        for (size_t row = first; row < csv.Rows() && samples < SampleRows; row++)
+        {
+            std::string_view cell = csv.Cell(row, col);
+            if (IsBlank(cell))
+                continue;
+            int64_t ns;
+            if (!ParseTimestamp(cell, ns))
+                return ColumnType::Number;
+            samples++;
+        }
+        return samples > 0 ? ColumnType::Time : ColumnType::Number;
+    }
+
+    // a cell without a number reads as NaN, a gap in the column
+    ParseResult ParseCell(std::string_view cell, ColumnType type, double& value)
+    {
+        value = std::numeric_limits<double>::quiet_NaN();
+        if (type == ColumnType::Number)
+            return ParseNumber(cell, value);
+        int64_t ns;
+        if (IsBlank(cell))
+            return ParseResult::Empty;
+        if (!ParseTimestamp(cell, ns))
+            return ParseResult::Invalid;
+        value = TimestampSeconds(ns);
+        return ParseResult::Ok;
+    }
+
+    // start of the line the first size bytes of a file end in, size if they end with a line break
+    uint64_t LastLineStart(std::ifstream& in, uint64_t size)
+    {
+        static const uint64_t Step = 4096;
+
+        char buffer[Step];
+        for (uint64_t end = size; end > 0;)
+        {
+            const uint64_t begin = end > Step ? end - Step : 0;
+            in.seekg(begin);
+            if (!in.read(buffer, end - begin))
+                break;
+            for (uint64_t pos = end; pos > begin; pos--)
+            {
+                if (buffer[pos - 1 - begin] == '\n')
+                    return pos;
+            }
+            end = begin;
+        }
+        return 0;
+    }
+
+    // 0 if unknown
+    uint64_t PhysicalMemory()
+    {
+        MEMORYSTATUSEX status = {};
+        status.dwLength = sizeof(status);
+        return GlobalMemoryStatusEx(&status) ? status.ullTotalPhys : 0;
+    }
+
+    std::vector<double> Decode(const ColumnBuffer& column)
+    {
+        std::vector<double> values(column.Size());
+        column.Visit([&](const auto& samples) {
+            for (size_t i = 0; i < values.size(); i++)
+                values[i] = samples[i];
+            });
+        return values;
+    }
+}
+
+bool Dataset::Load(const std::string& filename, unsigned threads, LoadMode mode, bool useCache, LoadProgress* progress)
+{
+    if (threads == 0)
+        threads = WorkerCount();
+    _threads = threads;
+    _filename = filename;
+    const bool keyRead = CacheKey::Read(filename, _key);
+    _useCache = useCache && keyRead;
+    const uint64_t memory = PhysicalMemory();
+    if (mode == LoadMode::Auto && keyRead && memory > 0 && _key.size > PagedMemoryShare * memory)
+        mode = LoadMode::Paged;
+    if (mode == LoadMode::Paged)
+        return keyRead && LoadPaged(progress);
+
+    // a cache written for the same file contents replaces parsing; its columns are views into the mapping
+    _fromCache = _useCache && _cache.Open(filename, _key);
+    if (_fromCache)
+    {
+        _bytes = static_cast<size_t>(_key.size);
+        _rows = _cache.Rows();
+        _header.resize(_cache.Columns());
+        for (size_t col = 0; col < _header.size(); col++)
+            _header[col] = _cache.Name(col);
+        _columns.assign(_header.size(), nullptr);
+        _issues.assign(_header.size(), ParseIssues());
+        if (progress)
+            progress->headerReady = true;
+        return true;
+    }
+
+    // without a field index cells are found by scanning their rows, which is what makes lazy loading cheap
+    const size_t maxIndexedFields = mode == LoadMode::Eager ? SIZE_MAX : mode == LoadMode::Lazy ? 0 : LazyColumns;
+    // parsing goes over the file a second time; count it from the start so the progress never runs backwards
+    const uint64_t parseBytes = progress && keyRead && mode != LoadMode::Lazy ? _key.size : 0;
+    if (progress)
+        progress->total += parseBytes;
+    if (!_csv.Open(filename, threads, maxIndexedFields, progress))
+        return false;
+    if (progress && !_csv.FieldsIndexed())
+        progress->total -= parseBytes;
+
+    _bytes = _csv.Bytes();
+    _rows = _csv.Rows() - 1;
+    std::vector<std::string_view> header(_csv.Fields(0));
+    _csv.Cells(0, header.size(), header.data());
+    _header.assign(header.begin(), header.end());
+    _columns.assign(_header.size(), nullptr);
+    _issues.assign(_header.size(), ParseIssues());
+    if (progress)
+        progress->headerReady = true;
+
+    if (_csv.FieldsIndexed())
+    {
+        std::vector<size_t> all(_header.size());
+        for (size_t col = 0; col < all.size(); col++)
+            all[col] = col;
+        if (progress && parseBytes != _bytes)
+            progress->total += _bytes - parseBytes;
+        Materialize(all, progress);
+        if (progress && progress->Cancelled())
+            return false;
+    }
+    return true;
+}
+
+void Dataset::Materialize(const std::vector<size_t>& cols, LoadProgress* progress)
+{
+    std::vector<size_t> pending;
+    for (size_t col : cols)
+    {
+        if (col < _columns.size() && !_columns[col] && std::find(pending.begin(), pending.end(), col) == pending.end())
+            pending.push_back(col);
+    }
+    if (pending.empty())
+        return;
+
+    if (_cache.IsOpen())
+    {
+        for (size_t col : pending)
+        {
+            _columns[col] = _cache.Column(col);
+            _issues[col] = _cache.Issues(col);
+            if (!_columns[col])
+                break;
+        }
+        if (std::any_of(pending.begin(), pending.end(), [&](size_t col) { return !_columns[col]; }))
+        {
+            // damaged: parse every column taken from it so far from the CSV too. Then nothing here keeps the
+            // cache mapped, and the cache written once all columns are parsed can replace it. A CSV that no
+            // longer holds the rows loaded leaves the columns missing from the cache unparsed.
+            if (!_csv.Open(_filename, _threads, 0) || _csv.Rows() - 1 != _rows || _csv.Bytes() != _bytes)
+            {
+                _csv = CsvFile();
+                return;
+            }
+            for (size_t col = 0; col < _columns.size(); col++)
+            {
+                if (_columns[col] && std::find(pending.begin(), pending.end(), col) == pending.end())
+                    pending.push_back(col);
+                _columns[col] = nullptr;
+                _issues[col] = ParseIssues();
+            }
+            _cache.Close();
+            _fromCache = false;
+        }
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&](size_t col) { return _columns[col] != nullptr; }), pending.end());
+        if (pending.empty())
+            return;
+    }
+    if (_csv.Rows() == 0)
+        return;
+
+    _progress = progress;
+    ParseColumns(std::move(pending));
+    _progress = nullptr;
+
+    // release the mapping and the row index once nothing is left to parse, and keep the result for next time
+    if (MaterializedColumns() == _columns.size())
+    {
+        _csv = CsvFile();
+        if (_useCache)
+        {
+            _cacheWrite = std::async(std::launch::async, [filename = _filename, key = _key, header = _header,
+                columns = std::vector<ColumnBufferPtr>(_columns.begin(), _columns.end()), issues = _issues]() {
+                return ColumnCache::Write(filename, key, header, columns, issues);
+                });
+        }
+    }
+}
+
+void Dataset::ParseColumns(std::vector<size_t> pending)
+{
+    std::vector<ColumnType> types(pending.size());
+    for (size_t i = 0; i < pending.size(); i++)
+        types[i] = DetectType(_csv, pending[i]);
+
+    std::vector<std::vector<double>> columns(pending.size(), std::vector<double>(_rows));
+    std::vector<std::vector<uint64_t>> valid(pending.size(), std::vector<uint64_t>(Bitmap::Words(_rows), ~uint64_t(0)));
+
+    // every thread parses a band of rows into all the pending columns; progress is counted in the
+    // share of the file's bytes the parsed rows stand for
+    static const size_t ReportRows = 16384;
+    const size_t width = *std::max_element(pending.begin(), pending.end()) + 1;
+    const size_t tasks = std::min<size_t>(_threads, std::max<size_t>(1, _rows / 4096));
+    auto bytesAt = [&](size_t row) { return _rows > 0 ? static_cast<uint64_t>(static_cast<double>(_bytes) * row / _rows) : 0; };
+    std::vector<std::vector<ParseIssues>> issues(tasks, std::vector<ParseIssues>(pending.size()));
+    std::vector<std::vector<char>> gaps(tasks, std::vector<char>(pending.size()));
+    // the bands start at whole bitmap words, so no two threads write the same word
+    auto bandStart = [&](size_t task) { return task == tasks ? _rows : _rows * task / tasks / Bitmap::WordBits * Bitmap::WordBits; };
+    ParallelFor(tasks, [&](size_t task) {
+        const size_t first = bandStart(task);
+        const size_t last = bandStart(task + 1);
+        std::vector<std::string_view> cells(width);
+        for (size_t row = first; row < last; row++)
+        {
+            _csv.Cells(row + 1, width, cells.data());
+            for (size_t i = 0; i < pending.size(); i++)
+            {
+                double& value = columns[i][row];
+                const ParseResult result = ParseCell(cells[pending[i]], types[i], value);
+                if (result != ParseResult::Ok)
+                    issues[task][i].Count(result, row);
+                if (value != value) // also a "nan" cell, which is a gap but no issue
+                {
+                    Bitmap::Clear(valid[i].data(), row);
+                    gaps[task][i] = true;
+                }
+            }
+            if (_progress && (row - first) % ReportRows == ReportRows - 1)
+            {
+                _progress->done += bytesAt(row + 1) - bytesAt(row + 1 - ReportRows);
+                if (_progress->Cancelled())
+                    return;
+            }
+        }
+        if (_progress)
+            _progress->done += bytesAt(last) - bytesAt(last - (last - first) % ReportRows);
+        });
+    if (_progress && _progress->Cancelled())
+        return;
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        bool any = false;
+        for (size_t task = 0; task < tasks; task++)
+        {
+            _issues[pending[i]].Add(issues[task][i]);
+            any = any || gaps[task][i];
+        }
+        if (!any)
+            valid[i].clear();
+    }
+
+    // the buffers build their pyramids and go to the narrowest exact storage, one column per task
+    const size_t columnTasks = std::min<size_t>(_threads, columns.size());
+    ParallelFor(columnTasks, [&](size_t task) {
+        for (size_t i = task; i < columns.size(); i += columnTasks)
+        {
+            auto column = std::make_shared<ColumnBuffer>(std::move(columns[i]), types[i], std::move(valid[i]));
+            column->Store(ChooseFormat(column->Data(), column->Size()), true);
+            _columns[pending[i]] = std::move(column);
+        }
+        });
+}
+
+bool Dataset::LoadPaged(LoadProgress* progress)
+{
+    // the page file is the cache of a paged file; without a usable one the CSV is parsed into a new one
+    _fromCache = _useCache && _pages.Open(_filename, _key);
+    if (!_fromCache && !(WritePages(progress) && _pages.Open(_filename, _key)))
+        return false;
+
+    _bytes = static_cast<size_t>(_key.size);
+    _rows = _pages.Rows();
+    _header.resize(_pages.Columns());
+    _columns.resize(_header.size());
+    _issues.resize(_header.size());
+    for (size_t col = 0; col < _header.size(); col++)
+    {
+        _header[col] = _pages.Name(col);
+        _columns[col] = _pages.Column(col);
+        _issues[col] = _pages.Issues(col);
+    }
+    if (progress)
+        progress->headerReady = true;
+    return true;
+}
+
+bool Dataset::WritePages(LoadProgress* progress)
+{
+    // the rows are indexed and parsed a group at a time, so neither the row index nor the samples are
+    // ever whole in memory; every thread parses a band of the group's rows
+    CsvFile csv;
+    if (csv.OpenWindow(_filename, 1) == 0)
+        return false;
+    std::vector<std::string_view> names(csv.Fields(0));
+    csv.Cells(0, names.size(), names.data());
+    const std::vector<std::string> header(names.begin(), names.end());
+    const int pageShift = PageFile::PageShiftFor(header.size());
+    const size_t pageRows = size_t(1) << pageShift;
+    if (progress)
+        progress->total += _key.size;
+
+    size_t rows = csv.NextWindow(pageRows);
+    std::vector<ColumnType> types(header.size());
+    for (size_t col = 0; col < types.size(); col++)
+        types[col] = DetectType(csv, col, 0);
+    PageFile::Writer writer;
+    if (!writer.Create(_filename, _key, header, types, pageShift))
+        return false;
+
+    std::vector<std::vector<double>> pages(header.size(), std::vector<double>(pageRows));
+    std::vector<ParseIssues> issues(header.size());
+    uint64_t reported = 0;
+    for (size_t first = 0; rows > 0; first += rows, rows = csv.NextWindow(pageRows))
+    {
+        const size_t tasks = std::min<size_t>(_threads, std::max<size_t>(1, rows / 4096));
+        std::vector<std::vector<ParseIssues>> bandIssues(tasks, std::vector<ParseIssues>(header.size()));
+        ParallelFor(tasks, [&](size_t task) {
+            std::vector<std::string_view> cells(header.size());
+            for (size_t row = rows * task / tasks; row < rows * (task + 1) / tasks; row++)
+            {
+                csv.Cells(row, cells.size(), cells.data());
+                for (size_t col = 0; col < cells.size(); col++)
+                {
+                    const ParseResult result = ParseCell(cells[col], types[col], pages[col][row]);
+                    if (result != ParseResult::Ok)
+                        bandIssues[task][col].Count(result, first + row);
+                }
+            }
+            });
+        for (size_t task = 0; task < tasks; task++)
+        {
+            for (size_t col = 0; col < issues.size(); col++)
+                issues[col].Add(bandIssues[task][col]);
+        }
+        if (!writer.Add(pages, rows))
+            return false;
+        if (progress)
+        {
+            progress->done += csv.WindowEnd() - reported;
+            reported = csv.WindowEnd();
+            if (progress->Cancelled())
+                return false;
+        }
+    }
+    if (progress)
+        progress->done += _key.size - reported;
+    return writer.Finish(issues);
+}
+
+size_t Dataset::Follow()
+{
+    // columns handed to the cache writer cannot grow until it is done with them; paged ones never do
+    if (Paged() || !CacheWritten())
+        return 0;
+
+    // every column grows by the same rows, so all of them have to be parsed
+    if (MaterializedColumns() != _columns.size() || _columns.empty())
+        return 0;
+
+    if (_followOffset == 0) // first call
+    {
+        std::ifstream in(_filename, std::ios::binary);
+        if (!in)
+            return 0;
+        _followOffset = _rows > 0 ? LastLineStart(in, _bytes) : _bytes;
+        // a lone '\r' before the end was a blank line to the indexer, not a row
+        char last = 0;
+        in.clear();
+        in.seekg(_bytes - 1);
+        in.get(last);
+        _partialRow = _followOffset < _bytes && !(_followOffset + 1 == _bytes && last == '\r');
+    }
+
+    // the complete rows written since, split as at load
+    CsvFile csv;
+    const size_t rows = csv.OpenWindow(_filename, SIZE_MAX, _followOffset, true);
+    if (rows > 0 && _partialRow)
+    {
+        // the issues of the row cut short were counted at load, from the bytes up to the end of the file then
+        CsvFile partial;
+        std::vector<std::string_view> cells(_columns.size());
+        if (partial.OpenWindow(_filename, 1, _followOffset, false, _bytes) == 1)
+        {
+            partial.Cells(0, cells.size(), cells.data());
+            for (size_t col = 0; col < _columns.size(); col++)
+            {
+                double value;
+                const ParseResult result = ParseCell(cells[col], _columns[col]->Type(), value);
+                if (result != ParseResult::Ok)
+                    _issues[col].Uncount(result);
+            }
+        }
+    }
+    if (csv.WindowEnd() > _followOffset) // blank lines are passed over too
+    {
+        _followOffset = csv.WindowEnd();
+        _bytes = csv.Bytes();
+    }
+    if (rows == 0)
+        return 0;
+    std::vector<std::vector<double>> values(_columns.size(), std::vector<double>(rows));
+    std::vector<std::string_view> cells(_columns.size());
+    for (size_t row = 0; row < rows; row++)
+    {
+        csv.Cells(row, cells.size(), cells.data());
+        const size_t fileRow = (_partialRow ? _rows - 1 : _rows) + row;
+        for (size_t col = 0; col < _columns.size(); col++)
+        {
+            const ParseResult result = ParseCell(cells[col], _columns[col]->Type(), values[col][row]);
+            if (result != ParseResult::Ok)
+                _issues[col].Count(result, fileRow);
+        }
+    }
+
+    const size_t from = _partialRow ? _rows - 1 : _rows;
+    for (size_t col = 0; col < _columns.size(); col++)
+        _columns[col]->Append(from, values[col].data(), rows);
+    _rows = from + rows;
+    _partialRow = false;
+    return rows;
+}
+
+bool Dataset::StoreExact(size_t col)
+{
+    if (Paged() || !Materialized(col) || !CacheWritten())
+        return false;
+    const std::vector<double> values = Decode(*_columns[col]);
+    _columns[col]->Store(ChooseFormat(values.data(), values.size()), true);
+    return true;
+}
+
+bool Dataset::StoreAs(size_t col, StorageType type)
+{
+    if (Paged() || !Materialized(col) || !CacheWritten())
+        return false;
+    if ((type == StorageType::Int32 || type == StorageType::Int16) && _columns[col]->HasGaps())
+        return false;
+    const std::vector<double> values = Decode(*_columns[col]);
+    const SampleFormat format = ForceFormat(type, values.data(), values.size());
+    _columns[col]->Store(format, Fits(values.data(), values.size(), format));
+    return true;
+}
+
+bool Dataset::CacheWritten()
+{
+    if (_cacheWrite.valid())
+    {
+        if (_cacheWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        _cacheWrite.get();
+    }
+    return true;
+}
+
+size_t Dataset::MaterializedColumns() const
+{
+    return std::count_if(_columns.begin(), _columns.end(), [](const ColumnBufferPtr& col) { return col != nullptr; });
+}
+
+size_t Dataset::DataBytes() const
+{
+    size_t bytes = 0;
+    for (auto& col : _columns)
+        bytes += col ? col->Bytes() : 0;
+    return bytes;
+}
+
+size_t Dataset::PyramidBytes() const
+{
+    size_t bytes = 0;
+    for (auto& col : _columns)
+        bytes += col ? col->Pyramid().Bytes() : 0;
+    return bytes;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <future>
+#include "CsvFile.h"
+#include "ColumnBuffer.h"
+#include "ColumnCache.h"
+#include "PageFile.h"
+#include "NumberParser.h"
+
+// Parsed contents of a CSV file: the header and one contiguous array of numbers per column.
+// Numbers are parsed once, plots share the column buffers.
+// Wide files are loaded lazily: loading only reads the header and indexes the rows, and a column is
+// parsed when it is materialized for its first use, so the cost depends on the columns actually used.
+// Once every column is parsed, the columns are written to a binary cache next to the file (in the
+// background); loading the same file again maps the cache instead of parsing.
+// A file that keeps growing can be followed: Follow() parses the complete rows written since the last
+// call and appends them to the columns, which every plot of them shares.
+// A file too large for memory is loaded paged: it is parsed once, a group of rows at a time, into a page
+// file next to it (PageFile.h), and its columns read their samples from there through the PageCache.
+// Paged columns cannot change: they neither follow their file nor change their storage type.
+class Dataset
+{
+public:
+	enum class LoadMode
+	{
+		Eager,	// parse every column at load
+		Lazy,	// parse columns on first use
+		Auto,	// lazy for files with more than LazyColumns columns, paged for files larger than memory allows
+		Paged	// keep the columns on disk
+	};
+	static const size_t LazyColumns = 256;
+	// Auto pages files larger than this share of the physical memory; their samples take about as much
+	static constexpr double PagedMemoryShare = 0.5;
+
+	// progress, when given, is updated as the file is indexed and parsed, sees headerReady as soon as the
+	// header can be read, and makes the load fail early when cancelled
+	bool Load(const std::string& filename, unsigned threads = 0, LoadMode mode = LoadMode::Auto, bool useCache = true,
+		LoadProgress* progress = nullptr);
+
+	size_t Columns() const { return _header.size(); }
+	size_t Rows() const { return _rows; }
+	const std::string& Name(size_t col) const { return _header[col]; }
+	// nullptr until the column is parsed, which takes a pass over the file: Materialize, off the UI thread
+	ColumnBufferPtr Column(size_t col) const { return _columns[col]; }
+	// parses the given columns that are not yet, in one pass over the file; progress, when given, counts the
+	// bytes of the rows parsed and leaves the columns unparsed when cancelled
+	void Materialize(const std::vector<size_t>& cols, LoadProgress* progress = nullptr);
+	bool Materialized(size_t col) const { return _columns[col] != nullptr; }
+	size_t MaterializedColumns() const;
+	bool FromCache() const { return _fromCache; }
+	bool Paged() const { return _pages.IsOpen(); }
+	// cells of a materialized column that held no number; they read as NaN, gaps in the column
+	const ParseIssues& Issues(size_t col) const { return _issues[col]; }
+
+	// Appends the rows completed in the file since the load or the last call, reading only the new bytes;
+	// returns how many. Nothing is appended until every column is parsed (Materialize). A row the file
+	// ended in the middle of at load is replaced once it is complete.
+	size_t Follow();
+
+	// Stores a materialized column in the narrowest type that holds its samples exactly (as at load), or in
+	// the given type, rounding the samples to its steps if they do not fit (compression keeps them
+	// exact). Integer types hold no gaps.
+	// False if the column cannot change now: it is paged or not parsed, or the cache is still being written from it.
+	bool StoreExact(size_t col);
+	bool StoreAs(size_t col, StorageType type);
+
+	size_t Bytes() const { return _bytes; }	// size of the CSV file
+	size_t DataBytes() const;
+	size_t PyramidBytes() const;
+	// of a paged file: its pages in the PageCache, and all of its pages
+	size_t ResidentBytes() const { return _pages.ResidentBytes(); }
+	size_t PagedBytes() const { return Paged() ? _rows * _header.size() * sizeof(double) : 0; }
+
+private:
+	void ParseColumns(std::vector<size_t> pending);	// from the CSV
+	bool LoadPaged(LoadProgress* progress);
+	bool WritePages(LoadProgress* progress);	// parses the CSV into its page file
+	bool CacheWritten();	// false while the cache writer still reads the columns
+
+	std::string _filename;
+	CacheKey _key;
+	bool _useCache = false;
+	bool _fromCache = false;
+	ColumnCache _cache;
+	PageFile _pages;
+	std::future<bool> _cacheWrite;	// the columns are read by it until it is done
+	LoadProgress* _progress = nullptr;	// only during Materialize
+	CsvFile _csv;	// kept open while columns are left to parse
+	unsigned _threads = 1;
+	std::vector<std::string> _header;
+	std::vector<std::shared_ptr<ColumnBuffer>> _columns;
+	std::vector<ParseIssues> _issues;
+	size_t _rows = 0;
+	size_t _bytes = 0;
+	bool _partialRow = false;	// the last row was cut short by the end of the file
+	uint64_t _followOffset = 0;	// start of the first row Follow() has not parsed, 0 before the first call
+};
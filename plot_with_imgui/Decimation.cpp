@@ -0,0 +1,234 @@
+#include "Decimation.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+bool LineLod::Update(const ColumnBuffer& data, const ColumnBuffer* xs, double xMin, double xMax, int pixels)
+{
+    const uint64_t xVersion = xs ? xs->Version() : 0;
+    if (&data == _data && xs == _x && data.Version() == _version && xVersion == _xVersion && xMin == _xMin && xMax == _xMax && pixels == _pixels)
+        return _decimated;
+
+    _data = &data;
+    _x = xs;
+    _version = data.Version();
+    _xVersion = xVersion;
+    _xMin = xMin;
+    _xMax = xMax;
+    _pixels = pixels;
+
+    // one sample beyond each edge, so the line runs to the border of the plot
+    if (xs)
+    {
+        _first = xs->LowerBound(xMin);
+        _first -= _first > 0 ? 1 : 0;
+        _last = std::min(data.Size(), xs->UpperBound(xMax) + 1);
+    }
+    else
+    {
+        const double size = static_cast<double>(data.Size());
+        _first = static_cast<size_t>(std::clamp(std::floor(xMin) - 1, 0.0, size));
+        _last = static_cast<size_t>(std::clamp(std::ceil(xMax) + 2, 0.0, size));
+    }
+
+    _xs.clear();
+    _ys.clear();
+    _decimated = pixels > 0 && xMax > xMin && _last - _first > 4 * static_cast<size_t>(pixels);
+    if (_decimated)
+    {
+        const double scale = pixels / (xMax - xMin);
+        const MinMaxPyramid& pyramid = data.Pyramid();
+        if (data.Format().type == StorageType::Paged && pyramid.Blocks() > 0 && _last - _first >= 2 * pyramid.Block() * pixels &&
+            (!xs || (xs->Pyramid().Block() == pyramid.Block() && xs->Pyramid().Blocks() == pyramid.Blocks() && xs->CountValid(0, xs->Size()) == xs->Size())))
+        {
+            DecimateBlocks(data, xs, xMin, scale);
+            return _decimated;
+        }
+        data.Visit([&](const auto& ys) {
+            if (xs)
+                xs->Visit([&](const auto& xv) { Decimate(data, xs, ys, xv, xMin, scale); });
+            else
+                Decimate(data, nullptr, ys, IndexSamples(), xMin, scale);
+            });
+    }
+    return _decimated;
+}
+
+template <typename YSamples, typename XSamples>
+void LineLod::Decimate(const ColumnBuffer& data, const ColumnBuffer* x, const YSamples& ys, const XSamples& xs, double xMin, double scale)
+{
+    const bool gaps = data.HasGaps();
+    const bool xGaps = x && x->HasGaps();
+    size_t i = _first;
+    while (i < _last)
+    {
+        // samples [i, end) fall in the same pixel column, that of firstX; the last of them has an X
+        size_t end;
+        double firstX;
+        if constexpr (!std::is_same_v<XSamples, IndexSamples>)
+        {
+            // samples without an X (gaps of the X column) are not drawn
+            size_t first = i;
+            firstX = xs[i];
+            while (firstX != firstX && ++first < _last)
+                firstX = xs[first];
+            if (first == _last)
+                break;
+            const double pixel = std::floor((firstX - xMin) * scale);
+            end = LowerBoundOf(xs, first + 1, _last, xMin + (pixel + 1) / scale);
+            end = std::clamp(end, first + 1, _last);
+        }
+        else
+        {
+            firstX = static_cast<double>(i);
+            const double pixel = std::floor((i - xMin) * scale);
+            end = static_cast<size_t>(std::max(0.0, std::ceil(xMin + (pixel + 1) / scale)));
+            end = std::clamp(end, i + 1, _last);
+        }
+
+        const size_t valid = gaps ? data.CountValid(i, end) : end - i;
+        if (xGaps && end - i > 4 && x->CountValid(i, end) < end - i)
+        {
+            // The pyramid would count in the samples without an X, so the pixel column is scanned for the
+            // first, min, max and last sample with both an X and a value.
+            size_t first = end, lo = end, hi = end, last = end;
+            for (size_t j = i; j < end; j++)
+            {
+                const double y = ys[j];
+                if (xs[j] != xs[j] || y != y)
+                    continue;
+                if (first == end)
+                    first = lo = hi = j;
+                if (y < ys[lo]) lo = j;
+                if (y > ys[hi]) hi = j;
+                last = j;
+            }
+            if (first == end)
+            {
+                if (!_ys.empty() && !std::isnan(_ys.back()))
+                {
+                    _xs.push_back(0.5 * (firstX + xs[end - 1])); _ys.push_back(std::numeric_limits<double>::quiet_NaN());
+                }
+            }
+            else
+            {
+                const size_t mid1 = std::min(lo, hi), mid2 = std::max(lo, hi);
+                Emit(xs, ys, first);
+                if (mid1 != first)
+                    Emit(xs, ys, mid1);
+                if (mid2 != mid1)
+                    Emit(xs, ys, mid2);
+                if (last != mid2)
+                    Emit(xs, ys, last);
+            }
+        }
+        else if (valid < end - i && end - i > 4)
+        {
+            // A gap narrower than the pixel column would not show, so such a column is drawn from its
+            // valid samples; a column without any breaks the line with a NaN, which ImPlot leaves out.
+            const double mid = 0.5 * (firstX + xs[end - 1]);
+            if (valid == 0)
+            {
+                if (!_ys.empty() && !std::isnan(_ys.back()))
+                {
+                    _xs.push_back(mid); _ys.push_back(std::numeric_limits<double>::quiet_NaN());
+                }
+            }
+            else
+            {
+                double lo, hi;
+                data.MinMax(i, end, lo, hi);
+                if (data.Valid(i))
+                    Emit(xs, ys, i);
+                _xs.push_back(mid); _ys.push_back(lo);
+                _xs.push_back(mid); _ys.push_back(hi);
+                if (data.Valid(end - 1))
+                    Emit(xs, ys, end - 1);
+            }
+        }
+        else if (end - i <= 4)
+        {
+            for (size_t j = i; j < end; j++)
+                Emit(xs, ys, j);
+        }
+        else if (end - i >= 2 * data.Pyramid().Block())
+        {
+            // wide pixel column: min and max come from the pyramid and are drawn as a vertical segment
+            // in the middle of the column, which covers the same pixels
+            double lo, hi;
+            data.MinMax(i, end, lo, hi);
+            const double mid = 0.5 * (firstX + xs[end - 1]);
+            Emit(xs, ys, i);
+            if (lo <= hi) // a paged column has no validity bitmap, its range can be all NaN
+            {
+                _xs.push_back(mid); _ys.push_back(lo);
+                _xs.push_back(mid); _ys.push_back(hi);
+            }
+            Emit(xs, ys, end - 1);
+        }
+        else
+        {
+            size_t lo = i, hi = i;
+            for (size_t j = i + 1; j < end; j++)
+            {
+                if (ys[j] < ys[lo]) lo = j;
+                if (ys[j] > ys[hi]) hi = j;
+            }
+            const size_t mid1 = std::min(lo, hi), mid2 = std::max(lo, hi);
+            Emit(xs, ys, i);
+            if (mid1 != i && mid1 != end - 1)
+                Emit(xs, ys, mid1);
+            if (mid2 != mid1 && mid2 != end - 1)
+                Emit(xs, ys, mid2);
+            Emit(xs, ys, end - 1);
+        }
+        i = end;
+    }
+}
+
+void LineLod::DecimateBlocks(const ColumnBuffer& data, const ColumnBuffer* xs, double xMin, double scale)
+{
+    const MinMaxPyramid& pyramid = data.Pyramid();
+    const size_t block = pyramid.Block();
+    const size_t size = data.Size();
+    // X of the first or last sample of a block, which are the min and max of its X
+    auto blockX = [&](size_t b, bool last) {
+        if (!xs)
+            return static_cast<double>(last ? std::min(size, (b + 1) * block) - 1 : b * block);
+        double lo, hi;
+        xs->Pyramid().BlockMinMax(b, b + 1, lo, hi);
+        return last ? hi : lo;
+    };
+
+    const size_t blocks = std::min(pyramid.Blocks(), (_last + block - 1) / block);
+    size_t b = _first / block;
+    while (b < blocks)
+    {
+        // blocks [b, end) start in the same pixel column
+        const double next = xMin + (std::floor((blockX(b, false) - xMin) * scale) + 1) / scale;
+        size_t end = b + 1;
+        for (size_t last = blocks; end < last;)
+        {
+            const size_t mid = end + (last - end) / 2;
+            if (blockX(mid, false) < next)
+                end = mid + 1;
+            else
+                last = mid;
+        }
+
+        double lo, hi;
+        pyramid.BlockMinMax(b, end, lo, hi);
+        const double mid = 0.5 * (blockX(b, false) + blockX(end - 1, true));
+        if (lo <= hi)
+        {
+            _xs.push_back(mid); _ys.push_back(lo);
+            _xs.push_back(mid); _ys.push_back(hi);
+        }
+        else if (!_ys.empty() && !std::isnan(_ys.back()))
+        {
+            _xs.push_back(mid); _ys.push_back(std::numeric_limits<double>::quiet_NaN());
+        }
+        b = end;
+    }
+}
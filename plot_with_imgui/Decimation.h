@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include "ColumnBuffer.h"
+
+// Level of detail for line plots. When a column has many more samples in view than the plot has pixels,
+// the visible samples are reduced to the first, minimum, maximum and last sample of every pixel column (M4).
+// Connecting those points lights the same pixels as connecting all the samples. Wide pixel columns take
+// their min/max from the column's pyramid, so rebuilding after a pan or zoom costs O(pixels * log N).
+// The result is kept until the view changes, so idle frames only resubmit a few points per pixel.
+// Of a compressed column only the blocks at the edges of the pixel columns are decoded. A paged column
+// with at least two blocks of its pyramid per pixel column is drawn from its pyramid (and that of its X)
+// alone, with the pixel columns cut at block edges, so zooming out reads no page.
+// Pixel columns where a column with gaps has no value become NaN points, which break the line there.
+// Samples without an X (gaps of the X column) are left out.
+class LineLod
+{
+public:
+	// Returns true if the visible range was decimated into Xs()/Ys(); otherwise the raw samples
+	// [First(), Last()) are few enough to plot directly. xs is the X column (it must be Monotonic()),
+	// null to plot against the sample index; the visible samples are found by binary search on it.
+	bool Update(const ColumnBuffer& data, const ColumnBuffer* xs, double xMin, double xMax, int pixels);
+
+	const double* Xs() const { return _xs.data(); }
+	const double* Ys() const { return _ys.data(); }
+	int Count() const { return static_cast<int>(_xs.size()); }
+	size_t First() const { return _first; }
+	size_t Last() const { return _last; }
+
+private:
+	template <typename YSamples, typename XSamples>
+	void Decimate(const ColumnBuffer& data, const ColumnBuffer* x, const YSamples& ys, const XSamples& xs, double xMin, double scale);
+	void DecimateBlocks(const ColumnBuffer& data, const ColumnBuffer* xs, double xMin, double scale);
+	template <typename YSamples, typename XSamples>
+	void Emit(const XSamples& xs, const YSamples& ys, size_t i)
+	{
+		const double x = xs[i];
+		if (x == x)
+		{
+			_xs.push_back(x);
+			_ys.push_back(ys[i]);
+		}
+	}
+
+	const ColumnBuffer* _data = nullptr;
+	const ColumnBuffer* _x = nullptr;
+	uint64_t _version = 0;
+	uint64_t _xVersion = 0;
+	double _xMin = 0;
+	double _xMax = 0;
+	int _pixels = 0;
+	bool _decimated = false;
+	size_t _first = 0;
+	size_t _last = 0;
+	std::vector<double> _xs;
+	std::vector<double> _ys;
+};
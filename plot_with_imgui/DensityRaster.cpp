@@ -0,0 +1,181 @@
+#include "DensityRaster.h"
+#include "PlotApp.h"
+#include "Parallel.h"
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+
+void TextureRelease::operator()(Texture* texture) const
+{
+    PlotApp::Instance().ReleaseTexture(*texture);
+    delete texture;
+}
+
+DensityRaster::DensityRaster() : _texture(new Texture)
+{
+}
+
+ImTextureID DensityRaster::Update(const ColumnBuffer& data, const ColumnBuffer* xs, size_t first, size_t last, const ImPlotRect& limits,
+    int width, int height, const ImVec4& color, float markerSize)
+{
+    if (width <= 0 || height <= 0)
+        return nullptr;
+
+    const uint64_t xVersion = xs ? xs->Version() : 0;
+    const bool sameBins = &data == _data && xs == _x && data.Version() == _version && xVersion == _xVersion && first == _first && last == _last && width == _width && height == _height &&
+        limits.X.Min == _limits.X.Min && limits.X.Max == _limits.X.Max && limits.Y.Min == _limits.Y.Min && limits.Y.Max == _limits.Y.Max;
+    const bool sameShade = color.x == _color.x && color.y == _color.y && color.z == _color.z && color.w == _color.w &&
+        markerSize == _markerSize;
+    if (sameBins && sameShade && _texture->view)
+        return (ImTextureID)_texture->view;
+
+    if (!sameBins)
+    {
+        data.Visit([&](const auto& ys) {
+            if (xs)
+                xs->Visit([&](const auto& xv) { Bin(ys, xv, xs->Monotonic(), first, last, limits, width, height); });
+            else
+                Bin(ys, IndexSamples(), true, first, last, limits, width, height);
+            });
+    }
+    Shade(width, height, color, static_cast<int>(std::ceil(markerSize)));
+
+    _data = &data;
+    _x = xs;
+    _version = data.Version();
+    _xVersion = xVersion;
+    _first = first;
+    _last = last;
+    _limits = limits;
+    _width = width;
+    _height = height;
+    _color = color;
+    _markerSize = markerSize;
+    return PlotApp::Instance().UpdateTexture(*_texture, width, height, _pixels.data());
+}
+
+template <typename YSamples, typename XSamples>
+void DensityRaster::Bin(const YSamples& ys, const XSamples& xs, bool sorted, size_t first, size_t last, const ImPlotRect& limits, int width, int height)
+{
+    static const size_t MinSamplesPerTask = 1 << 16;
+    static const size_t MaxTaskGridBytes = size_t(64) << 20;
+
+    const size_t cells = static_cast<size_t>(width) * height;
+    _counts.assign(cells, 0);
+    if (limits.X.Size() <= 0 || limits.Y.Size() <= 0)
+        return;
+
+    const double sx = width / limits.X.Size();
+    const double sy = height / limits.Y.Size();
+    // counts the samples [begin, end) into the pixel columns [colBegin, colEnd) of counts
+    auto count = [&](size_t begin, size_t end, int colBegin, int colEnd, unsigned int* counts) {
+        for (size_t i = begin; i < end; i++)
+        {
+            const double y = ys[i];
+            if (!(y >= limits.Y.Min && y < limits.Y.Max))
+                continue;
+            const double x = xs[i];
+            // a gap of X is not drawn; an unsorted X was not cut to the view beforehand
+            if (x != x || (!sorted && !(x >= limits.X.Min && x < limits.X.Max)))
+                continue;
+            const int col = std::clamp(static_cast<int>((x - limits.X.Min) * sx), colBegin, colEnd - 1);
+            const int row = std::min(static_cast<int>((limits.Y.Max - y) * sy), height - 1); // row 0 is the top of the plot
+            counts[static_cast<size_t>(row) * width + col]++;
+        }
+    };
+
+    if (!sorted)
+    {
+        // x in any order: every task counts a range of the samples into a grid of its own (task 0 into
+        // _counts), and the grids are added up by bands of rows
+        const size_t maxTasks = std::max<size_t>(1, MaxTaskGridBytes / (cells * sizeof(unsigned int)));
+        const size_t tasks = std::clamp<size_t>((last - first) / MinSamplesPerTask, 1, std::min<size_t>(WorkerCount(), maxTasks));
+        _taskCounts.assign((tasks - 1) * cells, 0);
+        ParallelFor(tasks, [&](size_t task) {
+            unsigned int* counts = task == 0 ? _counts.data() : &_taskCounts[(task - 1) * cells];
+            count(first + (last - first) * task / tasks, first + (last - first) * (task + 1) / tasks, 0, width, counts);
+            });
+        if (tasks > 1)
+        {
+            const size_t bands = std::min<size_t>(WorkerCount(), height);
+            ParallelFor(bands, [&](size_t band) {
+                const size_t begin = cells * band / bands;
+                const size_t end = cells * (band + 1) / bands;
+                for (size_t task = 1; task < tasks; task++)
+                {
+                    const unsigned int* counts = &_taskCounts[(task - 1) * cells];
+                    for (size_t cell = begin; cell < end; cell++)
+                        _counts[cell] += counts[cell];
+                }
+                });
+        }
+        return;
+    }
+
+    // x grows with the sample index, so each task owns a band of pixel columns and the samples in it;
+    // no two tasks write the same cell
+    auto firstSample = [&](int col) {
+        const double x = limits.X.Min + col / sx;
+        if constexpr (std::is_same_v<XSamples, IndexSamples>)
+            return std::clamp(static_cast<size_t>(std::max(0.0, std::ceil(x))), first, last);
+        else
+            return LowerBoundOf(xs, first, last, x);
+    };
+    const size_t tasks = std::clamp<size_t>((last - first) / MinSamplesPerTask, 1, WorkerCount());
+    ParallelFor(tasks, [&](size_t task) {
+        const int colBegin = static_cast<int>(width * task / tasks);
+        const int colEnd = static_cast<int>(width * (task + 1) / tasks);
+        count(firstSample(colBegin), firstSample(colEnd), colBegin, colEnd, _counts.data());
+        });
+}
+
+void DensityRaster::Shade(int width, int height, const ImVec4& color, int radius)
+{
+    const size_t cells = static_cast<size_t>(width) * height;
+    unsigned int maxCount = 0;
+    for (unsigned int count : _counts)
+        maxCount = std::max(maxCount, count);
+
+    // log scale, so single outliers stay visible next to dense regions
+    _opacity.assign(cells, 0.0f);
+    const float norm = maxCount > 0 ? 1.0f / std::log1p(static_cast<float>(maxCount)) : 0.0f;
+    for (size_t cell = 0; cell < cells; cell++)
+    {
+        if (_counts[cell])
+            _opacity[cell] = 0.25f + 0.75f * std::log1p(static_cast<float>(_counts[cell])) * norm;
+    }
+
+    // grow every point to the marker size: separable max filter, rows then columns
+    if (radius > 0)
+    {
+        std::vector<float> grown(cells);
+        const size_t tasks = std::min<size_t>(WorkerCount(), height);
+        ParallelFor(tasks, [&](size_t task) {
+            for (int row = static_cast<int>(height * task / tasks); row < static_cast<int>(height * (task + 1) / tasks); row++)
+            {
+                const float* in = &_opacity[static_cast<size_t>(row) * width];
+                float* out = &grown[static_cast<size_t>(row) * width];
+                for (int col = 0; col < width; col++)
+                    out[col] = *std::max_element(in + std::max(0, col - radius), in + std::min(width, col + radius + 1));
+            }
+            });
+        ParallelFor(tasks, [&](size_t task) {
+            for (int row = static_cast<int>(height * task / tasks); row < static_cast<int>(height * (task + 1) / tasks); row++)
+            {
+                float* out = &_opacity[static_cast<size_t>(row) * width];
+                std::fill(out, out + width, 0.0f);
+                for (int other = std::max(0, row - radius); other < std::min(height, row + radius + 1); other++)
+                {
+                    const float* in = &grown[static_cast<size_t>(other) * width];
+                    for (int col = 0; col < width; col++)
+                        out[col] = std::max(out[col], in[col]);
+                }
+            }
+            });
+    }
+
+    _pixels.resize(cells);
+    const ImU32 rgb = ImGui::ColorConvertFloat4ToU32(ImVec4(color.x, color.y, color.z, 0.0f));
+    for (size_t cell = 0; cell < cells; cell++)
+        _pixels[cell] = rgb | (static_cast<ImU32>(_opacity[cell] * color.w * 255.0f + 0.5f) << 24);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "../implot/implot.h"
+#include "ColumnBuffer.h"
+
+struct Texture;
+// hands a texture back to PlotApp, which frees it once no frame can draw it any more
+struct TextureRelease
+{
+	void operator()(Texture* texture) const;
+};
+
+// Scatter plots with too many visible points are drawn as an image instead of one marker per point:
+// the points are counted into a grid with one cell per plot pixel, the counts are mapped to opacity on
+// a log scale and spread by the marker radius so the shape matches the marker plot.
+class DensityRaster
+{
+public:
+	DensityRaster();
+
+	// bins data[first, last) over the plot limits, with x taken from xs or the sample index if xs is null;
+	// the texture is only rebuilt when the inputs change. Samples of an X column that is not Monotonic()
+	// are binned in any order, so first and last take in the whole column.
+	ImTextureID Update(const ColumnBuffer& data, const ColumnBuffer* xs, size_t first, size_t last, const ImPlotRect& limits,
+		int width, int height, const ImVec4& color, float markerSize);
+
+private:
+	template <typename YSamples, typename XSamples>
+	void Bin(const YSamples& ys, const XSamples& xs, bool sorted, size_t first, size_t last, const ImPlotRect& limits, int width, int height);
+	void Shade(int width, int height, const ImVec4& color, int radius);
+
+	const ColumnBuffer* _data = nullptr;
+	const ColumnBuffer* _x = nullptr;
+	uint64_t _version = 0;
+	uint64_t _xVersion = 0;
+	size_t _first = 0;
+	size_t _last = 0;
+	ImPlotRect _limits;
+	int _width = 0;
+	int _height = 0;
+	ImVec4 _color;
+	float _markerSize = 0;
+
+	std::vector<unsigned int> _counts;
+	std::vector<unsigned int> _taskCounts;	// the grids of the tasks binning an unsorted X, but the first
+	std::vector<float> _opacity;
+	std::vector<unsigned int> _pixels;
+	std::unique_ptr<Texture, TextureRelease> _texture;
+};
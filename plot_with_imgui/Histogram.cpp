@@ -0,0 +1,544 @@
+#include "Histogram.h"
+#include "Parallel.h"
+#include "PageCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HISTOGRAM_SSE2
+#endif
+
+namespace
+{
+    const size_t MinValuesPerTask = 1 << 16;
+
+    size_t TaskCount(size_t size)
+    {
+        // a task's private counts are 32 bit
+        return std::max(size / 0x7fffffff + 1, std::min<size_t>(WorkerCount(), size / MinValuesPerTask));
+    }
+
+    inline bool InRange(double v, double lo, double hi)
+    {
+        return v >= lo && v <= hi; // false for NaN
+    }
+
+    inline int BinOf(double v, double lo, double scale, int bins)
+    {
+        return std::min(static_cast<int>((v - lo) * scale), bins - 1);
+    }
+
+    // returns the number of values below lo
+    size_t CountSlice(const double* values, size_t size, double lo, double hi, double scale, int bins, uint32_t* counts)
+    {
+        size_t below = 0;
+        size_t i = 0;
+#ifdef HISTOGRAM_SSE2
+        // four bin indices at a time; out of range lanes are converted too but masked out when counting
+        const __m128d vlo = _mm_set1_pd(lo);
+        const __m128d vhi = _mm_set1_pd(hi);
+        const __m128d vscale = _mm_set1_pd(scale);
+        const __m128i vlast = _mm_set1_epi32(bins - 1);
+        alignas(16) int32_t lanes[4];
+        for (; i + 4 <= size; i += 4)
+        {
+            const __m128d a = _mm_loadu_pd(values + i);
+            const __m128d b = _mm_loadu_pd(values + i + 2);
+            const int in = _mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(a, vlo), _mm_cmple_pd(a, vhi))) |
+                (_mm_movemask_pd(_mm_and_pd(_mm_cmpge_pd(b, vlo), _mm_cmple_pd(b, vhi))) << 2);
+            const int under = _mm_movemask_pd(_mm_cmplt_pd(a, vlo)) | (_mm_movemask_pd(_mm_cmplt_pd(b, vlo)) << 2);
+            below += (under & 1) + ((under >> 1) & 1) + ((under >> 2) & 1) + ((under >> 3) & 1);
+            __m128i bin = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_mul_pd(_mm_sub_pd(a, vlo), vscale)),
+                _mm_cvttpd_epi32(_mm_mul_pd(_mm_sub_pd(b, vlo), vscale)));
+            const __m128i over = _mm_cmpgt_epi32(bin, vlast); // only the maximum itself lands past the last bin
+            bin = _mm_or_si128(_mm_and_si128(over, vlast), _mm_andnot_si128(over, bin));
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), bin);
+
+            if (in == 0xf)
+            {
+                counts[lanes[0]]++;
+                counts[lanes[1]]++;
+                counts[lanes[2]]++;
+                counts[lanes[3]]++;
+            }
+            else
+            {
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    if (in & (1 << lane))
+                        counts[lanes[lane]]++;
+                }
+            }
+        }
+#endif
+        for (; i < size; i++)
+        {
+            if (InRange(values[i], lo, hi))
+                counts[BinOf(values[i], lo, scale, bins)]++;
+            else if (values[i] < lo)
+                below++;
+        }
+        return below;
+    }
+
+    // narrow samples are decoded a piece at a time for the vectorized count of doubles
+    template <typename S>
+    size_t CountSamples(const S& values, size_t first, size_t last, double lo, double hi, double scale, int bins, uint32_t* counts)
+    {
+        if constexpr (std::is_same_v<S, Samples<double>>)
+            return CountSlice(values.data + first, last - first, lo, hi, scale, bins, counts);
+        else
+        {
+            static const size_t Piece = 1024;
+            double decoded[Piece];
+            size_t below = 0;
+            for (size_t i = first; i < last; i += Piece)
+            {
+                const size_t count = std::min(Piece, last - i);
+                for (size_t j = 0; j < count; j++)
+                    decoded[j] = values[i + j];
+                below += CountSlice(decoded, count, lo, hi, scale, bins, counts);
+            }
+            return below;
+        }
+    }
+
+    // counts the values of [lo, hi] into bins of equal width (hi goes to the last bin), every thread into
+    // private counts that are added up at the end; returns how many, below receives those under lo
+    template <typename S>
+    size_t BinSamples(const S& values, size_t size, double lo, double hi, int bins, std::vector<double>& counts, size_t* below = nullptr)
+    {
+        counts.assign(bins, 0.0);
+        if (below)
+            *below = 0;
+        if (size == 0 || bins <= 0)
+            return 0;
+
+        const double scale = hi > lo ? bins / (hi - lo) : 0.0;
+        const size_t tasks = TaskCount(size);
+        std::vector<std::vector<uint32_t>> taskCounts(tasks);
+        std::vector<size_t> taskBelow(tasks);
+        ParallelFor(tasks, [&](size_t task) {
+            const size_t first = size * task / tasks;
+            const size_t last = size * (task + 1) / tasks;
+            taskCounts[task].assign(bins, 0);
+            taskBelow[task] = CountSamples(values, first, last, lo, hi, scale, bins, taskCounts[task].data());
+            });
+
+        size_t counted = 0;
+        for (size_t task = 0; task < tasks; task++)
+        {
+            const std::vector<uint32_t>& local = taskCounts[task];
+            if (below)
+                *below += taskBelow[task];
+            for (int bin = 0; bin < bins; bin++)
+            {
+                counts[bin] += local[bin];
+                counted += local[bin];
+            }
+        }
+        return counted;
+    }
+
+    // the q-quantile of the values in [lo, hi] without sorting them: fine histograms narrow the range down to
+    // the bins around the rank, and only the values left are gathered and selected with nth_element
+    template <typename S>
+    double QuantileOf(const S& values, size_t size, double lo, double hi, double q)
+    {
+        static const int SelectBins = 1 << 16;
+        static const size_t MaxGather = 1 << 18;
+        static const int MaxPasses = 8;
+
+        std::vector<double> counts;
+        size_t below = 0;
+        size_t counted = BinSamples(values, size, lo, hi, SelectBins, counts, &below);
+        if (counted == 0)
+            return lo;
+        const size_t rank = std::min(counted - 1, static_cast<size_t>(std::clamp(q, 0.0, 1.0) * counted));
+
+        // narrow [lo, hi] to the bins around the one holding the rank until few enough values are left
+        for (int pass = 0; counted > MaxGather && pass < MaxPasses && hi > lo; pass++)
+        {
+            size_t inRange = rank - below;
+            int bin = 0;
+            while (inRange >= counts[bin])
+                inRange -= static_cast<size_t>(counts[bin++]);
+
+            // one extra bin on each side, so rounding at the bin edges cannot drop the rank out of the range
+            const double width = (hi - lo) / SelectBins;
+            const double newLo = std::max(lo, lo + (bin - 1) * width);
+            const double newHi = std::min(hi, lo + (bin + 2) * width);
+            if (newLo <= lo && newHi >= hi)
+                break;
+            lo = newLo;
+            hi = newHi;
+            counted = BinSamples(values, size, lo, hi, SelectBins, counts, &below);
+        }
+        if (hi <= lo)
+            return lo;
+
+        const size_t tasks = TaskCount(size);
+        // narrowing stops at a run of copies of one value; rather than gathering them, the values left are
+        // gone through from the smallest, counting its copies
+        while (counted > MaxGather)
+        {
+            std::vector<double> smallest(tasks, std::numeric_limits<double>::infinity());
+            std::vector<size_t> copies(tasks, 0);
+            ParallelFor(tasks, [&](size_t task) {
+                for (size_t i = size * task / tasks; i < size * (task + 1) / tasks; i++)
+                {
+                    const double v = values[i];
+                    if (!InRange(v, lo, hi) || v > smallest[task])
+                        continue;
+                    copies[task] = v < smallest[task] ? 1 : copies[task] + 1;
+                    smallest[task] = v;
+                }
+                });
+            const double value = *std::min_element(smallest.begin(), smallest.end());
+            size_t count = 0;
+            for (size_t task = 0; task < tasks; task++)
+                count += smallest[task] == value ? copies[task] : 0;
+            if (rank - below < count)
+                return value;
+            below += count;
+            counted -= count;
+            lo = std::nextafter(value, std::numeric_limits<double>::infinity());
+        }
+
+        std::vector<std::vector<double>> gathered(tasks);
+        ParallelFor(tasks, [&](size_t task) {
+            for (size_t i = size * task / tasks; i < size * (task + 1) / tasks; i++)
+            {
+                if (InRange(values[i], lo, hi))
+                    gathered[task].push_back(values[i]);
+            }
+            });
+
+        std::vector<double> candidates;
+        candidates.reserve(counted);
+        for (auto& local : gathered)
+            candidates.insert(candidates.end(), local.begin(), local.end());
+        std::nth_element(candidates.begin(), candidates.begin() + (rank - below), candidates.end());
+        return candidates[rank - below];
+    }
+
+    // the distances of the valid samples from center, summed and squared, on all cores
+    void SumAround(const ColumnBuffer& data, double center, double& sum, double& square)
+    {
+        const size_t size = data.Size();
+        const size_t tasks = TaskCount(size);
+        std::vector<double> sums(tasks), squares(tasks);
+        ParallelFor(tasks, [&](size_t task) {
+            double sum = 0, square = 0;
+            data.Visit([&](const auto& values) {
+                data.ForEachValidRun(size * task / tasks, size * (task + 1) / tasks, [&](size_t first, size_t last) {
+                    for (size_t i = first; i < last; i++)
+                    {
+                        // NaN only where there is no validity bitmap to leave it out, in a paged column
+                        const double d = values[i] - center;
+                        if (d == d)
+                        {
+                            sum += d;
+                            square += d * d;
+                        }
+                    }
+                    });
+                });
+            sums[task] = sum;
+            squares[task] = square;
+            });
+
+        sum = square = 0;
+        for (size_t task = 0; task < tasks; task++)
+        {
+            sum += sums[task];
+            square += squares[task];
+        }
+    }
+
+    // the mean and the standard deviation of the stats.count samples from their sums around center
+    void FinishStats(ColumnStats& stats, double center, double sum, double square)
+    {
+        const double n = static_cast<double>(stats.count);
+        stats.mean = center + sum / n;
+        stats.stddev = stats.count > 1 ? std::sqrt(std::max(0.0, (square - sum * sum / n) / (n - 1))) : 0.0;
+    }
+
+    // the distance of a sample from center added to (sign 1) or taken from (sign -1) sum and square,
+    // if it holds a value
+    inline void AddAround(double value, double center, double sign, double& sum, double& square)
+    {
+        const double d = value - center;
+        if (d == d)
+        {
+            sum += sign * d;
+            square += sign * d * d;
+        }
+    }
+
+    // the last count samples of data, fewer if it is shorter
+    void TailOf(const ColumnBuffer& data, size_t count, std::vector<double>& tail)
+    {
+        const size_t first = data.Size() - std::min(count, data.Size());
+        tail.resize(data.Size() - first);
+        data.Visit([&](const auto& values) {
+            for (size_t i = first; i < data.Size(); i++)
+                tail[i - first] = values[i];
+            });
+    }
+}
+
+void HistogramCache::Update(const ColumnBufferPtr& data, int bins, bool cumulative, bool density, bool noOutliers)
+{
+    if (_scan && _scan->done.load(std::memory_order_acquire))
+    {
+        _binned = std::move(_scan->binned);
+        _scan.reset();
+        Shape();
+    }
+    if (cumulative != _cumulative || density != _density)
+    {
+        _cumulative = cumulative;
+        _density = density;
+        Shape();
+    }
+    if (data->Version() == _version && std::max(1, bins) == _bins && noOutliers == _noOutliers)
+        return;
+
+    // the fences move with every sample, the edges without outliers only with the min and the max
+    const bool appended = std::max(1, bins) == _bins && !noOutliers && !_noOutliers && !_scan &&
+        Extend(*data, data->UnchangedUntil(_version), _binned);
+    _version = data->Version();
+    _bins = std::max(1, bins);
+    _noOutliers = noOutliers;
+
+    if (data->Format().type != StorageType::Paged)
+    {
+        _scan.reset();
+        if (!appended)
+            Rebin(*data, _bins, _noOutliers, _binned);
+        Shape();
+        return;
+    }
+
+    // replacing the scan of the previous settings stops it at its next page
+    _scan = std::make_shared<Scan>();
+    _scan->size = data->Size() * (noOutliers ? 2 : 1);
+    std::thread([owner = std::weak_ptr<Scan>(_scan), data, bins = _bins, noOutliers]() {
+        Binned binned;
+        if (!RebinPaged(*data, bins, noOutliers, owner, binned))
+            return;
+        if (std::shared_ptr<Scan> scan = owner.lock())
+        {
+            scan->binned = std::move(binned);
+            scan->done.store(true, std::memory_order_release);
+        }
+        }).detach();
+}
+
+double HistogramCache::Scanning() const
+{
+    if (!_scan)
+        return -1.0;
+    return _scan->size > 0 ? static_cast<double>(_scan->read) / _scan->size : 1.0;
+}
+
+void HistogramCache::Rebin(const ColumnBuffer& data, int bins, bool noOutliers, Binned& binned)
+{
+    auto start = std::chrono::steady_clock::now();
+    binned.counts.assign(bins, 0.0);
+    binned.counted = 0;
+    binned.stats = ColumnStats();
+    binned.stats.count = data.CountValid(0, data.Size());
+    binned.size = data.Size();
+    TailOf(data, TailSamples, binned.tail);
+    if (binned.stats.count > 0)
+    {
+        data.MinMax(0, data.Size(), binned.stats.min, binned.stats.max);
+        binned.center = 0.5 * (binned.stats.min + binned.stats.max);
+        SumAround(data, binned.center, binned.sum, binned.square);
+        FinishStats(binned.stats, binned.center, binned.sum, binned.square);
+
+        double lo = binned.stats.min, hi = binned.stats.max;
+        binned.counted = data.Visit([&](const auto& values) {
+            if (noOutliers)
+            {
+                // Tukey's fences: values further than 1.5 interquartile ranges from the quartiles are outliers
+                const double q1 = QuantileOf(values, data.Size(), lo, hi, 0.25);
+                const double q3 = QuantileOf(values, data.Size(), lo, hi, 0.75);
+                lo = std::max(lo, q1 - 1.5 * (q3 - q1));
+                hi = std::min(hi, q3 + 1.5 * (q3 - q1));
+            }
+            if (hi <= lo)
+                hi = lo + 1.0;
+
+            binned.binWidth = (hi - lo) / bins;
+            auto binStart = std::chrono::steady_clock::now();
+            const size_t counted = BinSamples(values, data.Size(), lo, hi, bins, binned.counts);
+            binned.binSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - binStart).count();
+            return counted;
+            });
+        binned.lo = lo;
+        binned.hi = hi;
+    }
+    binned.bytes = static_cast<double>(data.Bytes());
+    binned.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool HistogramCache::RebinPaged(const ColumnBuffer& data, int bins, bool noOutliers, const std::weak_ptr<Scan>& owner, Binned& binned)
+{
+    static const int SelectBins = 1 << 16;
+    auto start = std::chrono::steady_clock::now();
+    const PagedColumn* column = nullptr;
+    data.Visit([&](const auto& values) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(values)>, PagedSamples>)
+            column = values.column;
+        });
+
+    // one pass over the pages, on this thread; false once the scan was dropped
+    std::vector<uint32_t> pageCounts;
+    auto pass = [&](int passBins, double lo, double hi, std::vector<double>& counts, auto&& sum) {
+        const double scale = hi > lo ? passBins / (hi - lo) : 0.0;
+        counts.assign(passBins, 0.0);
+        return Paging::ForEachPage(*column, 0, column->size, [&](const double* values, size_t count) {
+            std::shared_ptr<Scan> scan = owner.lock();
+            if (!scan)
+                return false;
+            sum(values, count);
+            pageCounts.assign(passBins, 0);
+            CountSlice(values, count, lo, hi, scale, passBins, pageCounts.data());
+            for (int bin = 0; bin < passBins; bin++)
+                counts[bin] += pageCounts[bin];
+            scan->read += count;
+            return true;
+            });
+    };
+
+    ColumnStats& stats = binned.stats;
+    binned.counts.assign(bins, 0.0);
+    stats.count = data.CountValid(0, data.Size());
+    if (stats.count == 0)
+        return true;
+    data.MinMax(0, data.Size(), stats.min, stats.max);
+    const double center = 0.5 * (stats.min + stats.max);
+    double sum = 0, square = 0;
+    auto addSums = [&](const double* values, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            AddAround(values[i], center, 1.0, sum, square);
+    };
+
+    double lo = stats.min, hi = stats.max;
+    if (noOutliers)
+    {
+        // the quartiles from a fine histogram, read in the pass of the sums; placing them linearly inside
+        // their bin is close enough for the fences and saves the passes Quantile narrows down with
+        std::vector<double> fine;
+        if (!pass(SelectBins, lo, hi, fine, addSums))
+            return false;
+        const double width = (hi - lo) / SelectBins;
+        auto quartile = [&](double q) {
+            double rank = q * stats.count;
+            int bin = 0;
+            while (bin < SelectBins - 1 && rank >= fine[bin])
+                rank -= fine[bin++];
+            return lo + width * (bin + (fine[bin] > 0 ? std::min(1.0, rank / fine[bin]) : 0.0));
+        };
+        const double q1 = quartile(0.25);
+        const double q3 = quartile(0.75);
+        lo = std::max(lo, q1 - 1.5 * (q3 - q1));
+        hi = std::min(hi, q3 + 1.5 * (q3 - q1));
+    }
+    if (hi <= lo)
+        hi = lo + 1.0;
+    auto binStart = std::chrono::steady_clock::now();
+    const bool complete = pass(bins, lo, hi, binned.counts, [&](const double* values, size_t count) {
+        if (!noOutliers)
+            addSums(values, count);
+        });
+    if (!complete)
+        return false;
+
+    binned.lo = lo;
+    binned.hi = hi;
+    binned.binWidth = (hi - lo) / bins;
+    for (double count : binned.counts)
+        binned.counted += static_cast<size_t>(count);
+    FinishStats(stats, center, sum, square);
+    binned.size = data.Size();
+    binned.bytes = static_cast<double>(data.Bytes());
+    binned.binSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - binStart).count();
+    binned.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool HistogramCache::Extend(const ColumnBuffer& data, size_t unchanged, Binned& binned)
+{
+    if (unchanged == 0 || binned.stats.count == 0 || unchanged > binned.size || binned.size - unchanged > binned.tail.size())
+        return false;
+    double min, max;
+    data.MinMax(0, data.Size(), min, max);
+    if (min != binned.stats.min || max != binned.stats.max)
+        return false;
+
+    const int bins = static_cast<int>(binned.counts.size());
+    const double lo = binned.lo, hi = binned.hi;
+    const double scale = hi > lo ? bins / (hi - lo) : 0.0;
+    const double* replaced = binned.tail.data() + binned.tail.size() - (binned.size - unchanged);
+    for (size_t i = 0; i < binned.size - unchanged; i++)
+    {
+        if (InRange(replaced[i], lo, hi))
+        {
+            binned.counts[BinOf(replaced[i], lo, scale, bins)]--;
+            binned.counted--;
+        }
+        AddAround(replaced[i], binned.center, -1.0, binned.sum, binned.square);
+    }
+
+    std::vector<uint32_t> added(bins, 0);
+    data.Visit([&](const auto& values) {
+        CountSamples(values, unchanged, data.Size(), lo, hi, scale, bins, added.data());
+        for (size_t i = unchanged; i < data.Size(); i++)
+            AddAround(values[i], binned.center, 1.0, binned.sum, binned.square);
+        });
+    for (int bin = 0; bin < bins; bin++)
+    {
+        binned.counts[bin] += added[bin];
+        binned.counted += added[bin];
+    }
+
+    binned.stats.count = data.CountValid(0, data.Size());
+    FinishStats(binned.stats, binned.center, binned.sum, binned.square);
+    binned.size = data.Size();
+    TailOf(data, TailSamples, binned.tail);
+    return true;
+}
+
+void HistogramCache::Shape()
+{
+    const int bins = static_cast<int>(_binned.counts.size());
+    _counts = _binned.counts;
+    _centers.resize(bins);
+    for (int bin = 0; bin < bins; bin++)
+        _centers[bin] = _binned.lo + _binned.binWidth * (bin + 0.5);
+
+    const size_t counted = _binned.counted;
+    if (_cumulative)
+    {
+        for (int bin = 1; bin < bins; bin++)
+            _counts[bin] += _counts[bin - 1];
+        if (_density && counted > 0)
+        {
+            for (double& count : _counts)
+                count /= counted;
+        }
+    }
+    else if (_density && counted > 0)
+    {
+        for (double& count : _counts)
+            count /= counted * _binned.binWidth;
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "ColumnBuffer.h"
+
+// Summary of the samples of a column that hold a value; gaps are left out, not read as 0.
+struct ColumnStats
+{
+	size_t count = 0;
+	double mean = 0;
+	double stddev = 0;
+	double min = 0;
+	double max = 0;
+};
+
+// Bin edges and counts of a histogram column. They are recomputed only when the data, the bin count or
+// the outlier setting changes, drawing them is a single bars call. Rows appended to a followed column are
+// only added to the bins, as long as the column's min and max, and so the bin edges, stay the same.
+// A paged column is binned on a thread of its own, reading its pages past the PageCache, as binning it
+// scans the whole file: until the scan is done the previous bins are drawn and Scanning() tells how far it got.
+class HistogramCache
+{
+public:
+	void Update(const ColumnBufferPtr& data, int bins, bool cumulative, bool density, bool noOutliers);
+
+	const double* Centers() const { return _centers.data(); }
+	const double* Counts() const { return _counts.data(); }
+	int Bins() const { return static_cast<int>(_counts.size()); }
+	double BinWidth() const { return _binned.binWidth; }
+	const ColumnStats& Stats() const { return _binned.stats; }
+
+	double RebinSeconds() const { return _binned.seconds; }
+	// bytes of samples binned per second by the binning pass alone, without the stats and the outlier search;
+	// for a paged column the pass also reads the pages, and the sums of the stats without outlier removal
+	double RebinBytesPerSecond() const { return _binned.binSeconds > 0 ? _binned.bytes / _binned.binSeconds : 0.0; }
+	// the fraction of a paged column read while it is binned in the background, negative when there is no scan
+	double Scanning() const;
+
+private:
+	// counts before Cumulative and Density are applied
+	struct Binned
+	{
+		double lo = 0;
+		double hi = 0;
+		double binWidth = 1.0;
+		std::vector<double> counts;
+		size_t counted = 0;
+		ColumnStats stats;
+		double center = 0;	// the stats' sums, of the samples' distances from center
+		double sum = 0;
+		double square = 0;
+		size_t size = 0;			// samples binned
+		std::vector<double> tail;	// the last of them, which an append may replace
+		double seconds = 0;
+		double binSeconds = 0;	// of the binning pass
+		double bytes = 0;
+	};
+	static const size_t TailSamples = 64;
+	// the background binning of a paged column; the thread holds it weakly and stops once it is dropped
+	struct Scan
+	{
+		size_t size = 0;
+		std::atomic<size_t> read{ 0 };	// samples, over all passes
+		std::atomic<bool> done{ false };
+		Binned binned;	// written by the thread before done
+	};
+
+	static void Rebin(const ColumnBuffer& data, int bins, bool noOutliers, Binned& binned);
+	// adds the samples from unchanged on to the bins, taking out those they replaced; false if the edges
+	// would change or the replaced samples are not in the tail
+	static bool Extend(const ColumnBuffer& data, size_t unchanged, Binned& binned);
+	static bool RebinPaged(const ColumnBuffer& data, int bins, bool noOutliers, const std::weak_ptr<Scan>& owner, Binned& binned);
+	void Shape();
+
+	uint64_t _version = 0;
+	int _bins = 0;
+	bool _cumulative = false;
+	bool _density = false;
+	bool _noOutliers = false;
+
+	Binned _binned;
+	std::vector<double> _centers;
+	std::vector<double> _counts;
+	std::shared_ptr<Scan> _scan;
+};
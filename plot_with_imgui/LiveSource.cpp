@@ -0,0 +1,112 @@
+#include "LiveSource.h"
+#include "SignalGenerator.h"
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const double RingSeconds = 0.25;	// of samples the rings hold while the UI thread is busy
+}
+
+void LiveSource::Start(const Settings& settings)
+{
+    Stop();
+    _settings = settings;
+    _settings.channels = std::max(1, _settings.channels);
+    _settings.capacity = std::max<size_t>(1, _settings.capacity);
+    _settings.rate = Settings::ClampRate(_settings.rate);
+    const size_t channels = static_cast<size_t>(_settings.channels) + 1;
+    const size_t ringSize = static_cast<size_t>(std::max(1024.0, _settings.rate * RingSeconds));
+
+    _rings.clear();
+    _columns.clear();
+    _names.clear();
+    for (size_t channel = 0; channel < channels; channel++)
+    {
+        _rings.push_back(std::make_unique<SpscRing<double>>(ringSize));
+        _columns.push_back(std::make_shared<ColumnBuffer>(std::vector<double>(), channel == 0 ? ColumnType::Time : ColumnType::Number));
+        _names.push_back(channel == 0 ? "time" : "live " + std::to_string(channel));
+    }
+    _dropped = 0;
+    _throughput = 0;
+    _windowSamples = 0;
+    _windowStart = std::chrono::steady_clock::now();
+    _stop = false;
+    _producer = std::thread([this]() { Generate(); });
+}
+
+void LiveSource::Stop()
+{
+    if (!_producer.joinable())
+        return;
+    _stop = true;
+    _producer.join();
+}
+
+size_t LiveSource::Drain()
+{
+    if (_rings.empty())
+        return 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    // the producer pushes each batch into every ring, so the smallest count is complete on all channels
+    size_t count = SIZE_MAX;
+    for (auto& ring : _rings)
+        count = std::min(count, ring->Available());
+
+    // the channels move their windows back at different times, a slack of half to all of the capacity
+    const size_t capacity = _settings.capacity;
+    for (size_t channel = 0; channel < _rings.size(); channel++)
+    {
+        const size_t slack = capacity / 2 + capacity / 2 * channel / _rings.size();
+        ColumnBuffer& column = *_columns[channel];
+        _rings[channel]->Consume(count, [&](const double* values, size_t n) { column.Scroll(values, n, capacity, slack); });
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    _drainSeconds = std::chrono::duration<double>(now - start).count();
+    _windowSamples += count;
+    const double window = std::chrono::duration<double>(now - _windowStart).count();
+    if (window >= 1.0)
+    {
+        _throughput = _windowSamples / window;
+        _windowSamples = 0;
+        _windowStart = now;
+    }
+    return count;
+}
+
+// The signals come from SignalGenerator. The samples are paced by the clock and made
+// in batches; a batch goes into every ring or, as far as the rings are full, into none.
+void LiveSource::Generate()
+{
+    static const size_t Batch = 4096;
+
+    const size_t channels = _rings.size();
+    const double rate = _settings.rate;
+    std::vector<std::vector<double>> batch(channels, std::vector<double>(Batch));
+
+    const auto start = std::chrono::steady_clock::now();
+    SignalGenerator generator(channels, rate, std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count());
+    uint64_t produced = 0;
+    while (!_stop)
+    {
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const uint64_t due = static_cast<uint64_t>(elapsed * rate);
+        if (due <= produced)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(Batch, due - produced));
+        generator.Next(batch, count);
+
+        size_t room = count;
+        for (auto& ring : _rings)
+            room = std::min(room, ring->Free());
+        for (size_t channel = 0; channel < channels; channel++)
+            _rings[channel]->Push(batch[channel].data(), room);
+        _dropped += count - room;
+        produced += count;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "SpscRing.h"
+#include "ColumnBuffer.h"
+
+// Live telemetry. A producer thread pushes samples into one lock-free ring per channel and the UI thread
+// drains the rings into scrolling column buffers once per frame, so neither side ever waits for the
+// other. Channel 0 holds the time of the samples (seconds since the epoch), the others the signals.
+// The producer here is a local generator; a socket or device reader would push through the same rings.
+class LiveSource
+{
+public:
+	struct Settings
+	{
+		int channels = 16;			// signals, not counting the time
+		double rate = 1e6;			// samples per second and channel, within [MinRate, MaxRate]
+		size_t capacity = 1 << 19;	// newest samples kept per channel
+
+		static constexpr double MinRate = 1.0;
+		static constexpr double MaxRate = 1e8;	// the rings hold a quarter second, 200 MB per channel
+		// NaN goes to MinRate
+		static double ClampRate(double rate) { return std::min(MaxRate, std::max(MinRate, rate)); }
+	};
+
+	LiveSource() = default;
+	~LiveSource() { Stop(); }
+	LiveSource(const LiveSource&) = delete;
+	LiveSource& operator=(const LiveSource&) = delete;
+
+	void Start(const Settings& settings);
+	void Stop();
+	bool Running() const { return _producer.joinable(); }
+
+	// UI thread: moves what was pushed since the last call into the columns, the same number of samples
+	// into every channel; returns how many per channel
+	size_t Drain();
+
+	size_t Channels() const { return _columns.size(); }	// with the time
+	const std::string& Name(size_t channel) const { return _names[channel]; }
+	ColumnBufferPtr Column(size_t channel) const { return _columns[channel]; }
+	const Settings& GetSettings() const { return _settings; }
+
+	// samples per second and channel drained over the last second
+	double Throughput() const { return _throughput; }
+	// samples per channel the producer had to throw away because the UI did not drain the rings in time
+	uint64_t Dropped() const { return _dropped; }
+	double DrainSeconds() const { return _drainSeconds; }	// of the last Drain()
+
+private:
+	void Generate();
+
+	Settings _settings;
+	std::vector<std::unique_ptr<SpscRing<double>>> _rings;
+	std::vector<std::shared_ptr<ColumnBuffer>> _columns;
+	std::vector<std::string> _names;
+	std::thread _producer;
+	std::atomic<bool> _stop{ false };
+	std::atomic<uint64_t> _dropped{ 0 };
+
+	std::chrono::steady_clock::time_point _windowStart;
+	size_t _windowSamples = 0;
+	double _throughput = 0;
+	double _drainSeconds = 0;
+};
@@ -0,0 +1,102 @@
+#include "LoadQueue.h"
+#include <algorithm>
+
+float LoadJob::Fraction() const
+{
+    if (finished)
+        return 1.0f;
+    const uint64_t total = progress.total;
+    return total > 0 ? std::min(1.0f, static_cast<float>(progress.done) / total) : 0.0f;
+}
+
+double LoadJob::BytesPerSecond() const
+{
+    if (!started)
+        return 0.0;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds > 0.0 ? progress.done / seconds : 0.0;
+}
+
+LoadQueue::LoadQueue(unsigned workers)
+{
+    for (unsigned i = 0; i < workers; i++)
+        _workers.emplace_back([this]() { Work(); });
+}
+
+LoadQueue::~LoadQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+        for (auto& job : _running)
+            job->progress.cancel = true;
+    }
+    _wake.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+std::shared_ptr<LoadJob> LoadQueue::Add(const std::string& filename, Dataset::LoadMode mode)
+{
+    auto job = std::make_shared<LoadJob>();
+    job->filename = filename;
+    job->mode = mode;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(job);
+    }
+    _wake.notify_one();
+    return job;
+}
+
+std::shared_ptr<LoadJob> LoadQueue::Add(Dataset&& data, std::vector<size_t> columns)
+{
+    auto job = std::make_shared<LoadJob>();
+    job->data = std::move(data);
+    job->columns = std::move(columns);
+    job->progress.total = job->data.Bytes();
+    job->progress.headerReady = true;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(job);
+    }
+    _wake.notify_one();
+    return job;
+}
+
+void LoadQueue::Work()
+{
+    for (;;)
+    {
+        std::shared_ptr<LoadJob> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this]() { return _stop || !_queue.empty(); });
+            if (_stop)
+                return;
+            job = std::move(_queue.front());
+            _queue.pop_front();
+            _running.push_back(job);
+        }
+
+        job->start = std::chrono::steady_clock::now();
+        job->started = true;
+        if (job->columns.empty())
+        {
+            job->loaded = !job->progress.Cancelled() &&
+                job->data.Load(job->filename, 0, job->mode, true, &job->progress) && job->data.Columns() > 0;
+        }
+        else
+        {
+            if (!job->progress.Cancelled())
+                job->data.Materialize(job->columns, &job->progress);
+            job->loaded = std::all_of(job->columns.begin(), job->columns.end(), [&](size_t col) { return job->data.Materialized(col); });
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running.erase(std::find(_running.begin(), _running.end(), job));
+        }
+        job->finished = true;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include "Dataset.h"
+
+// A file loading in a LoadQueue, or the lazy columns of a loaded one being parsed. The UI thread watches
+// progress and may cancel; data belongs to the worker until finished is set (only its header may be read
+// once progress.headerReady is set).
+struct LoadJob
+{
+	std::string filename;
+	Dataset::LoadMode mode = Dataset::LoadMode::Auto;
+	Dataset data;
+	std::vector<size_t> columns;	// to parse of data, which is already loaded; empty to load filename
+	LoadProgress progress;
+	std::atomic<bool> started{ false };
+	std::atomic<bool> finished{ false };
+	std::chrono::steady_clock::time_point start;	// valid once started
+	bool loaded = false;							// valid once finished; all of columns parsed for a parsing job
+
+	float Fraction() const;
+	// bytes indexed and parsed per second since a worker picked the job up
+	double BytesPerSecond() const;
+};
+
+// Loads dropped files on worker threads so the UI keeps drawing while they parse. Every load already
+// spreads over all cores, so a couple of workers are enough to keep a small file from waiting behind a big one.
+class LoadQueue
+{
+public:
+	explicit LoadQueue(unsigned workers = 2);
+	// cancels the loads still queued or running
+	~LoadQueue();
+	LoadQueue(const LoadQueue&) = delete;
+	LoadQueue& operator=(const LoadQueue&) = delete;
+
+	std::shared_ptr<LoadJob> Add(const std::string& filename, Dataset::LoadMode mode = Dataset::LoadMode::Auto);
+	// parses the given columns of a loaded dataset, which the job holds until it is finished
+	std::shared_ptr<LoadJob> Add(Dataset&& data, std::vector<size_t> columns);
+
+private:
+	void Work();
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::deque<std::shared_ptr<LoadJob>> _queue;
+	std::vector<std::shared_ptr<LoadJob>> _running;
+	std::vector<std::thread> _workers;
+	bool _stop = false;
+};
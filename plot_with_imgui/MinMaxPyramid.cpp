@@ -0,0 +1,329 @@
+#include "MinMaxPyramid.h"
+#include <algorithm>
+#include <limits>
+
+template <typename S>
+MinMaxPyramid::Range MinMaxPyramid::RangeOf(const S& data, size_t begin, size_t end)
+{
+    // NaN samples (gaps) are the second operand of min and max and so never taken; a block of gaps only
+    // has the bounds (+inf, -inf), which nothing lies inside
+    Range range = { std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+    for (size_t i = begin; i < end; i++)
+    {
+        const double v = data[i];
+        range.lo = std::min(range.lo, v);
+        range.hi = std::max(range.hi, v);
+    }
+    return range;
+}
+
+void MinMaxPyramid::Merge(size_t first, const std::vector<size_t>& sizes)
+{
+    _levels.resize(sizes.size());
+    for (size_t level = 1; level < _levels.size(); level++)
+    {
+        const std::vector<Range>& below = _levels[level - 1];
+        std::vector<Range>& above = _levels[level];
+        first >>= 1;
+        above.resize(sizes[level]);
+        for (size_t block = first; block < above.size(); block++)
+        {
+            above[block] = below[2 * block];
+            if (2 * block + 1 < below.size())
+            {
+                above[block].lo = std::min(above[block].lo, below[2 * block + 1].lo);
+                above[block].hi = std::max(above[block].hi, below[2 * block + 1].hi);
+            }
+        }
+    }
+}
+
+template <typename S>
+void MinMaxPyramid::Build(const S& data, size_t size)
+{
+    _levels.clear();
+    const std::vector<size_t> sizes = LevelSizes(size);
+    if (sizes.empty())
+        return;
+
+    std::vector<Range> level(sizes[0]);
+    for (size_t block = 0; block < level.size(); block++)
+        level[block] = RangeOf(data, block << _shift, std::min(size, (block + 1) << _shift));
+    _levels.push_back(std::move(level));
+    Merge(0, sizes);
+}
+
+template <typename S>
+void MinMaxPyramid::Update(const S& data, size_t from, size_t size)
+{
+    // a pyramid too small to exist yet is built from scratch, which costs no more than the new samples
+    if (_levels.empty())
+    {
+        Build(data, size);
+        return;
+    }
+
+    const std::vector<size_t> sizes = LevelSizes(size);
+    if (sizes.empty())
+    {
+        _levels.clear();
+        return;
+    }
+    const size_t first = from >> _shift;
+    std::vector<Range>& bottom = _levels[0];
+    bottom.resize(sizes[0]);
+    for (size_t block = first; block < bottom.size(); block++)
+        bottom[block] = RangeOf(data, block << _shift, std::min(size, (block + 1) << _shift));
+    Merge(first, sizes);
+}
+
+void MinMaxPyramid::Append(const double* values, size_t from, size_t size)
+{
+    if (from == 0)
+    {
+        Build(Samples<double>{ values, 0, 1 }, size);
+        return;
+    }
+    const std::vector<size_t> sizes = LevelSizes(size);
+    if (_levels.empty() || sizes.empty())
+        return;
+
+    const size_t first = from >> _shift;
+    std::vector<Range>& bottom = _levels[0];
+    bottom.resize(sizes[0]);
+    for (size_t block = first; block < bottom.size(); block++)
+        bottom[block] = RangeOf(values, (block << _shift) - from, std::min(size, (block + 1) << _shift) - from);
+    Merge(first, sizes);
+}
+
+void MinMaxPyramid::Drop(const double* data, size_t samples, size_t size)
+{
+    const std::vector<size_t> sizes = LevelSizes(size);
+    if (_levels.empty() || sizes.empty())
+    {
+        Build(Samples<double>{ data, 0, 1 }, size);
+        return;
+    }
+
+    // level 0 moves along with the samples, the levels above are merged again from it, which costs
+    // a sixteenth of rebuilding
+    std::vector<Range>& bottom = _levels[0];
+    bottom.erase(bottom.begin(), bottom.begin() + std::min(bottom.size(), samples >> _shift));
+    bottom.resize(sizes[0]);
+    Merge(0, sizes);
+}
+
+void MinMaxPyramid::Query(const SampleReader& data, size_t begin, size_t end, double& lo, double& hi) const
+{
+    lo = std::numeric_limits<double>::infinity();
+    hi = -std::numeric_limits<double>::infinity();
+
+    // whole level-0 blocks inside the range
+    const size_t first = (begin + Block() - 1) >> _shift;
+    const size_t last = end >> _shift;
+    if (_levels.empty() || first >= last)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            lo = std::min(lo, data[i]);
+            hi = std::max(hi, data[i]);
+        }
+        return;
+    }
+
+    for (size_t i = begin; i < (first << _shift); i++)
+    {
+        lo = std::min(lo, data[i]);
+        hi = std::max(hi, data[i]);
+    }
+    for (size_t i = last << _shift; i < end; i++)
+    {
+        lo = std::min(lo, data[i]);
+        hi = std::max(hi, data[i]);
+    }
+    Climb(first, last, lo, hi);
+}
+
+void MinMaxPyramid::BlockMinMax(size_t first, size_t last, double& lo, double& hi) const
+{
+    lo = std::numeric_limits<double>::infinity();
+    hi = -std::numeric_limits<double>::infinity();
+    Climb(first, last, lo, hi);
+}
+
+void MinMaxPyramid::Climb(size_t first, size_t last, double& lo, double& hi) const
+{
+    // take the odd blocks at both ends of the remaining range, then go up a level
+    for (size_t level = 0; level < _levels.size() && first < last; level++)
+    {
+        const std::vector<Range>& blocks = _levels[level];
+        if (first & 1)
+        {
+            lo = std::min(lo, blocks[first].lo);
+            hi = std::max(hi, blocks[first].hi);
+            first++;
+        }
+        if (last & 1)
+        {
+            last--;
+            lo = std::min(lo, blocks[last].lo);
+            hi = std::max(hi, blocks[last].hi);
+        }
+        first >>= 1;
+        last >>= 1;
+    }
+}
+
+size_t MinMaxPyramid::Nearest(const SampleReader& data, const SampleReader* xs, size_t begin, size_t end, double x, double y, double sx, double sy, double& dist2) const
+{
+    size_t best = end;
+    dist2 = std::numeric_limits<double>::infinity();
+    auto scan = [&](size_t first, size_t last) {
+        for (size_t i = std::max(first, begin); i < std::min(last, end); i++)
+        {
+            const double dx = ((xs ? (*xs)[i - begin] : static_cast<double>(i - begin)) - x) * sx;
+            const double dy = (data[i] - y) * sy;
+            const double d = dx * dx + dy * dy;
+            if (d < dist2)
+            {
+                dist2 = d;
+                best = i;
+            }
+        }
+    };
+    if (_levels.empty())
+    {
+        scan(begin, end);
+        return best;
+    }
+
+    // squared scaled distance from (x, y) to the bounding box of a block; the box of a block reaching
+    // outside [begin, end) also holds samples that are not searched, which only loosens the bound
+    auto bound = [&](size_t level, size_t block) {
+        const size_t shift = level + _shift;
+        const size_t first = std::max(begin, block << shift);
+        const size_t last = std::min(end, (block + 1) << shift) - 1;
+        const double firstX = xs ? (*xs)[first - begin] : static_cast<double>(first - begin);
+        const double lastX = xs ? (*xs)[last - begin] : static_cast<double>(last - begin);
+        const Range& range = _levels[level][block];
+        const double dx = (x < firstX ? firstX - x : x > lastX ? x - lastX : 0.0) * sx;
+        const double dy = (y < range.lo ? range.lo - y : y > range.hi ? y - range.hi : 0.0) * sy;
+        return dx * dx + dy * dy;
+    };
+    auto inside = [&](size_t level, size_t block) {
+        const size_t shift = level + _shift;
+        return (block << shift) < end && ((block + 1) << shift) > begin;
+    };
+
+    struct Node
+    {
+        size_t level;
+        size_t block;
+        double bound;
+    };
+    std::vector<Node> stack;
+    const size_t top = _levels.size() - 1;
+    if (begin >= end)
+        return best;
+    stack.push_back({ top, 0, bound(top, 0) });
+    while (!stack.empty())
+    {
+        const Node node = stack.back();
+        stack.pop_back();
+        if (node.bound >= dist2)
+            continue;
+        if (node.level == 0)
+        {
+            scan(node.block << _shift, (node.block + 1) << _shift);
+            continue;
+        }
+
+        // push the farther child first so the nearer one is searched first and tightens dist2
+        Node children[2];
+        int count = 0;
+        for (size_t child = 2 * node.block; child < std::min(2 * node.block + 2, _levels[node.level - 1].size()); child++)
+        {
+            if (inside(node.level - 1, child))
+                children[count++] = { node.level - 1, child, bound(node.level - 1, child) };
+        }
+        if (count == 2 && children[0].bound < children[1].bound)
+            std::swap(children[0], children[1]);
+        for (int i = 0; i < count; i++)
+        {
+            if (children[i].bound < dist2)
+                stack.push_back(children[i]);
+        }
+    }
+    return best;
+}
+
+size_t MinMaxPyramid::Bytes() const
+{
+    size_t bytes = 0;
+    for (auto& level : _levels)
+        bytes += level.size() * sizeof(Range);
+    return bytes;
+}
+
+std::vector<size_t> MinMaxPyramid::LevelSizes(size_t size) const
+{
+    std::vector<size_t> sizes;
+    if (size < 2 * Block())
+        return sizes;
+    sizes.push_back((size + Block() - 1) >> _shift);
+    while (sizes.back() > 1)
+        sizes.push_back((sizes.back() + 1) / 2);
+    return sizes;
+}
+
+std::vector<double> MinMaxPyramid::Flatten() const
+{
+    std::vector<double> values;
+    values.reserve(Bytes() / sizeof(double));
+    for (auto& level : _levels)
+    {
+        for (auto& range : level)
+        {
+            values.push_back(range.lo);
+            values.push_back(range.hi);
+        }
+    }
+    return values;
+}
+
+bool MinMaxPyramid::Restore(const double* values, size_t count, size_t size)
+{
+    _levels.clear();
+    std::vector<size_t> sizes = LevelSizes(size);
+    size_t total = 0;
+    for (size_t blocks : sizes)
+        total += 2 * blocks;
+    if (total != count)
+        return false;
+
+    for (size_t blocks : sizes)
+    {
+        std::vector<Range> level(blocks);
+        for (auto& range : level)
+        {
+            range.lo = *values++;
+            range.hi = *values++;
+        }
+        _levels.push_back(std::move(level));
+    }
+    return true;
+}
+
+// the storage types of columns
+template void MinMaxPyramid::Build(const Samples<double>&, size_t);
+template void MinMaxPyramid::Build(const Samples<float>&, size_t);
+template void MinMaxPyramid::Build(const Samples<int32_t>&, size_t);
+template void MinMaxPyramid::Build(const Samples<int16_t>&, size_t);
+template void MinMaxPyramid::Build(const CompressedSamples&, size_t);
+template void MinMaxPyramid::Build(const PagedSamples&, size_t);
+template void MinMaxPyramid::Update(const Samples<double>&, size_t, size_t);
+template void MinMaxPyramid::Update(const Samples<float>&, size_t, size_t);
+template void MinMaxPyramid::Update(const Samples<int32_t>&, size_t, size_t);
+template void MinMaxPyramid::Update(const Samples<int16_t>&, size_t, size_t);
+template void MinMaxPyramid::Update(const CompressedSamples&, size_t, size_t);
+template void MinMaxPyramid::Update(const PagedSamples&, size_t, size_t);
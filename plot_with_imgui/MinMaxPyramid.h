@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include "SampleStorage.h"
+
+// Min/max summaries of a column at power-of-two block sizes, like mipmaps. Level 0 holds one min/max
+// pair per Block() samples and every further level halves the number of blocks, so the pyramid adds
+// about N/8 values to a column of N samples in memory. Compressed columns have a block per compression
+// block and paged columns much coarser ones, see PageFile.h. The min and max of any sample range is found from at most two blocks per level plus the
+// unaligned samples at both ends.
+// NaN samples are left out of every min and max; a range of nothing but NaN has lo = +inf, hi = -inf.
+class MinMaxPyramid
+{
+public:
+	// of the columns in memory
+	static const int BlockShift = 5;
+	static const size_t BlockSize = size_t(1) << BlockShift;
+
+	explicit MinMaxPyramid(int blockShift = BlockShift) : _shift(blockShift) {}
+	int Shift() const { return _shift; }
+	size_t Block() const { return size_t(1) << _shift; }
+	// level-0 blocks, 0 for a column too short to have a pyramid
+	size_t Blocks() const { return _levels.empty() ? 0 : _levels[0].size(); }
+
+	// Build and Update read the samples through a Samples<T> view of their storage type
+	template <typename S>
+	void Build(const S& data, size_t size);
+	// brings the pyramid up to date after data[from, size) was appended or rewritten; only the blocks
+	// covering those samples are recomputed
+	template <typename S>
+	void Update(const S& data, size_t from, size_t size);
+	// the same for a pyramid built a piece at a time: values holds data[from, size), from is a multiple
+	// of Block() and the pyramid already covers data[0, from) (it is built whole when from is 0)
+	void Append(const double* values, size_t from, size_t size);
+	// min and max of data[begin, end); data must be the samples the pyramid was built from
+	void Query(const SampleReader& data, size_t begin, size_t end, double& lo, double& hi) const;
+	// min and max of the level-0 blocks [first, last), from the pyramid alone
+	void BlockMinMax(size_t first, size_t last, double& lo, double& hi) const;
+	// data[0, size) was moved from data[samples, samples + size); samples must be a multiple of Block().
+	// Only scrolling buffers drop samples, and they hold doubles.
+	void Drop(const double* data, size_t samples, size_t size);
+	// Index in [begin, end) of the sample nearest to (x, y) when sample i is drawn at (xs[i - begin], data[i]),
+	// or at (i - begin, data[i]) if xs is null, and distances are measured after scaling x by sx and y by sy
+	// (pixels per unit); end if the range is empty. end must be the size the pyramid was built for and
+	// xs must never decrease.
+	// Blocks are searched nearest first and skipped once their bounding box is farther than the best
+	// sample so far, so a query touches O(log N) blocks for most views. dist2 receives the scaled squared distance.
+	size_t Nearest(const SampleReader& data, const SampleReader* xs, size_t begin, size_t end, double x, double y, double sx, double sy, double& dist2) const;
+
+	size_t Bytes() const;
+
+	// every level one after the other as (lo, hi) pairs, to be stored along with the column
+	std::vector<double> Flatten() const;
+	// the pyramid of a column of size samples from Flatten()ed values; false if count does not fit size
+	bool Restore(const double* values, size_t count, size_t size);
+
+private:
+	struct Range
+	{
+		double lo;
+		double hi;
+	};
+
+	std::vector<size_t> LevelSizes(size_t size) const;
+	template <typename S>
+	static Range RangeOf(const S& data, size_t begin, size_t end);
+	// resizes the levels above 0 to sizes and recomputes them from level-0 block first on
+	void Merge(size_t first, const std::vector<size_t>& sizes);
+	// adds the blocks [first, last) of the levels to lo and hi, climbing as far as they go
+	void Climb(size_t first, size_t last, double& lo, double& hi) const;
+
+	int _shift;
+	std::vector<std::vector<Range>> _levels;
+};
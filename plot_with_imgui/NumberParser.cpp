@@ -0,0 +1,119 @@
+#include "NumberParser.h"
+#include <charconv>
+
+namespace
+{
+    // every power of ten a double holds exactly
+    const double ExactPowers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const int MaxExactPower = 22;
+    const uint64_t MaxExactMantissa = 1ull << 53;
+    const int MaxDigits = 19; // 10^19 - 1 fits in 64 bits
+
+    inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    inline unsigned Digit(char c) { return static_cast<unsigned>(c - '0'); }
+
+    ParseResult FromChars(const char* begin, const char* end, bool negative, double& value)
+    {
+        const auto result = std::from_chars(begin, end, value);
+        if (result.ec != std::errc() || result.ptr != end)
+            return ParseResult::Invalid;
+        value = negative ? -value : value;
+        return ParseResult::Ok;
+    }
+}
+
+ParseResult ParseNumber(const char* begin, const char* end, double& value)
+{
+    while (begin < end && IsBlank(*begin))
+        begin++;
+    while (end > begin && IsBlank(end[-1]))
+        end--;
+    if (begin == end)
+        return ParseResult::Empty;
+
+    const char* pos = begin;
+    const bool negative = *pos == '-';
+    if (*pos == '-' || *pos == '+')
+        pos++;
+    const char* number = pos; // from_chars takes no '+', so the sign is applied here
+
+    // the first MaxDigits significant digits go into the mantissa, later ones only move the exponent
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool any = false;
+    for (; pos < end && Digit(*pos) < 10; pos++)
+    {
+        any = true;
+        if (digits < MaxDigits)
+        {
+            mantissa = mantissa * 10 + Digit(*pos);
+            digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+            truncated |= *pos != '0';
+        }
+    }
+    if (pos < end && *pos == '.')
+    {
+        for (pos++; pos < end && Digit(*pos) < 10; pos++)
+        {
+            any = true;
+            if (digits < MaxDigits)
+            {
+                mantissa = mantissa * 10 + Digit(*pos);
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else
+                truncated |= *pos != '0';
+        }
+    }
+    if (!any) // "inf", "nan" or nothing
+        return number < end && *number != '-' && *number != '+' ? FromChars(number, end, negative, value) : ParseResult::Invalid;
+
+    if (pos < end && (*pos == 'e' || *pos == 'E'))
+    {
+        pos++;
+        const bool negativeExponent = pos < end && *pos == '-';
+        if (pos < end && (*pos == '-' || *pos == '+'))
+            pos++;
+        if (pos == end || Digit(*pos) >= 10)
+            return ParseResult::Invalid;
+        int power = 0;
+        for (; pos < end && Digit(*pos) < 10; pos++)
+            power = power < 100000 ? power * 10 + static_cast<int>(Digit(*pos)) : power;
+        exponent += negativeExponent ? -power : power;
+    }
+    if (pos != end)
+        return ParseResult::Invalid;
+
+    // an exact mantissa and an exact power of ten: one IEEE operation rounds correctly
+    if (!truncated && mantissa <= MaxExactMantissa)
+    {
+        double result = static_cast<double>(mantissa);
+        if (exponent >= -MaxExactPower && exponent <= MaxExactPower)
+            result = exponent < 0 ? result / ExactPowers[-exponent] : result * ExactPowers[exponent];
+        else if (exponent > MaxExactPower && exponent <= MaxExactPower + 15)
+        {
+            // "12e25": move the excess power into the mantissa while it stays exact
+            uint64_t shifted = mantissa;
+            for (int i = MaxExactPower; i < exponent && shifted <= MaxExactMantissa; i++)
+                shifted *= 10;
+            if (shifted > MaxExactMantissa)
+                return FromChars(number, end, negative, value);
+            result = static_cast<double>(shifted) * ExactPowers[MaxExactPower];
+        }
+        else
+            return FromChars(number, end, negative, value);
+        value = negative ? -result : result;
+        return ParseResult::Ok;
+    }
+    return FromChars(number, end, negative, value);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+enum class ParseResult
+{
+	Ok,
+	Empty,		// nothing but blanks
+	Invalid		// not a number, not only a number, or out of the range of a double
+};
+
+// Parses a decimal number from a byte range of the input, without copying or allocating and independent
+// of the locale: blanks around it, a sign, digits with an optional '.', an optional exponent, "inf" and
+// "nan". The result is correctly rounded. Numbers with at most 19 significant digits whose value and power
+// of ten are both exact doubles (most cells: "12.345", "-0.5", "1.234567e-05") take one multiplication
+// or division; the rest go to std::from_chars.
+ParseResult ParseNumber(const char* begin, const char* end, double& value);
+
+inline ParseResult ParseNumber(std::string_view str, double& value)
+{
+	return ParseNumber(str.data(), str.data() + str.size(), value);
+}
+
+// Cells of a column that did not hold a value
+struct ParseIssues
+{
+	uint64_t empty = 0;
+	uint64_t invalid = 0;
+	uint64_t firstInvalid = UINT64_MAX;	// row, counted from the first row after the header
+
+	void Count(ParseResult result, uint64_t row)
+	{
+		if (result == ParseResult::Empty)
+			empty++;
+		else
+		{
+			invalid++;
+			firstInvalid = row < firstInvalid ? row : firstInvalid;
+		}
+	}
+	// takes back the Count of the last row counted
+	void Uncount(ParseResult result)
+	{
+		if (result == ParseResult::Empty)
+			empty--;
+		else if (--invalid == 0)
+			firstInvalid = UINT64_MAX;
+	}
+	void Add(const ParseIssues& other)
+	{
+		empty += other.empty;
+		invalid += other.invalid;
+		firstInvalid = other.firstInvalid < firstInvalid ? other.firstInvalid : firstInvalid;
+	}
+	bool Any() const { return empty + invalid > 0; }
+};
@@ -0,0 +1,157 @@
+#include "PageCache.h"
+#include <Windows.h>
+#include <algorithm>
+#include <limits>
+
+PageSource::~PageSource()
+{
+    PageCache::Instance().Forget(*this);
+    if (_file)
+        CloseHandle(_file);
+}
+
+bool PageSource::Open(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    _file = file;
+    return true;
+}
+
+uint64_t PageSource::Size() const
+{
+    LARGE_INTEGER size;
+    return GetFileSizeEx(_file, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+}
+
+bool PageSource::Read(uint64_t offset, void* out, size_t bytes) const
+{
+    // the offset goes with every read, so threads reading different pages need no lock
+    char* to = static_cast<char*>(out);
+    while (bytes > 0)
+    {
+        OVERLAPPED at = {};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(bytes, 1u << 30));
+        DWORD read = 0;
+        if (!ReadFile(_file, to, chunk, &read, &at) || read == 0)
+            return false;
+        to += read;
+        offset += read;
+        bytes -= read;
+    }
+    return true;
+}
+
+void PageCache::SetBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = bytes;
+    Evict();
+}
+
+PagePtr PageCache::Get(const PagedColumn& column, size_t page)
+{
+    const Key key = { column.id, page };
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _index.find(key);
+        if (found != _index.end())
+        {
+            _lru.splice(_lru.begin(), _lru, found->second);
+            return found->second->page;
+        }
+    }
+
+    // read without the lock, so other threads keep finding their resident pages; two threads may read
+    // the same page, the second one takes the first one's
+    bool failed;
+    PagePtr values = Read(column, page, failed);
+    if (failed)
+        return values;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _index.find(key);
+    if (found != _index.end())
+        return found->second->page;
+    _lru.push_front({ key, column.source, values });
+    _index[key] = _lru.begin();
+    const size_t bytes = values->size() * sizeof(double);
+    _resident += bytes;
+    column.source->_resident += bytes;
+    Evict();
+    return values;
+}
+
+PagePtr PageCache::Peek(const PagedColumn& column, size_t page)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _index.find({ column.id, page });
+        if (found != _index.end())
+            return found->second->page;
+    }
+    bool failed;
+    return Read(column, page, failed);
+}
+
+PagePtr PageCache::Read(const PagedColumn& column, size_t page, bool& failed)
+{
+    const size_t pageRows = size_t(1) << column.pageShift;
+    auto values = std::make_shared<std::vector<double>>(pageRows);
+    const size_t rows = std::min(pageRows, column.size - std::min(column.size, page * pageRows));
+    _reads++;
+    failed = !column.source->Read(column.offset + page * column.stride, values->data(), rows * sizeof(double));
+    if (failed)
+    {
+        _failures++;
+        std::fill(values->begin(), values->end(), std::numeric_limits<double>::quiet_NaN());
+    }
+    return values;
+}
+
+void PageCache::Forget(const PageSource& source)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto entry = _lru.begin(); entry != _lru.end();)
+    {
+        if (entry->source != &source)
+        {
+            ++entry;
+            continue;
+        }
+        const size_t bytes = entry->page->size() * sizeof(double);
+        _resident -= bytes;
+        source._resident -= bytes;
+        _index.erase(entry->key);
+        entry = _lru.erase(entry);
+    }
+}
+
+void PageCache::Evict()
+{
+    // the page just read stays, even when a single page is over the budget
+    while (_resident > _budget && _lru.size() > 1)
+    {
+        const Entry& entry = _lru.back();
+        const size_t bytes = entry.page->size() * sizeof(double);
+        _resident -= bytes;
+        entry.source->_resident -= bytes;
+        _index.erase(entry.key);
+        _lru.pop_back();
+    }
+}
+
+namespace Paging
+{
+    const double* Page(const PagedColumn& column, size_t page)
+    {
+        return HeldPages::Get(column.id, page, [&](PagePtr& held) {
+            held = PageCache::Instance().Get(column, page);
+            return held->data();
+            });
+    }
+}
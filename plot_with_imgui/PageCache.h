@@ -0,0 +1,148 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "ThreadBlockCache.h"
+
+// Pages of columns kept on disk (PageFile.h), for recordings larger than memory. A page is read the first
+// time a sample of it is needed and kept while it is among the most recently used pages that fit the memory
+// budget, which the user sets; the least recently used ones are dropped to make room. Besides the budget,
+// every thread holds on to the few pages it read last (see Paging::Page).
+typedef std::shared_ptr<const std::vector<double>> PagePtr;
+
+class PageSource;
+
+// One column of a page file: its pages lie stride bytes apart from offset on, pageRows samples each.
+struct PagedColumn
+{
+	const PageSource* source;
+	uint64_t id;			// unique, tells the columns apart in the cache
+	uint64_t offset;
+	uint64_t stride;
+	int pageShift;			// pageRows = 1 << pageShift
+	size_t size;
+	std::vector<double> pageMax;	// largest sample of every page, for searches in monotonic columns
+};
+
+// An open page file, which the ColumnBuffers of its columns keep alive; its pages leave the cache with it.
+class PageSource
+{
+public:
+	PageSource() = default;
+	~PageSource();
+	PageSource(const PageSource&) = delete;
+	PageSource& operator=(const PageSource&) = delete;
+
+	bool Open(const std::string& path);
+	uint64_t Size() const;
+	// false if the bytes cannot all be read
+	bool Read(uint64_t offset, void* out, size_t bytes) const;
+
+	std::vector<PagedColumn> columns;
+	// bytes of its pages in the cache
+	size_t Resident() const { return _resident; }
+
+private:
+	friend class PageCache;
+	void* _file = nullptr;
+	mutable std::atomic<size_t> _resident{ 0 };
+};
+
+class PageCache
+{
+public:
+	static const size_t DefaultBudget = size_t(1) << 30;
+
+	// never destroyed, as the sources of datasets destroyed at exit still drop their pages from it
+	static PageCache& Instance() { static PageCache* instance = new PageCache; return *instance; }
+
+	// drops the least recently used pages until the resident ones fit
+	void SetBudget(size_t bytes);
+	size_t Budget() const { return _budget; }
+	size_t Resident() const { return _resident; }
+	// pages read from disk so far, and reads that failed
+	uint64_t Reads() const { return _reads; }
+	uint64_t Failures() const { return _failures; }
+
+	// the page of a column, read from its file if it is not resident; a page that cannot be read is NaN and
+	// not made resident, so the next Get reads it again. The page stays valid while the PagePtr is held, also
+	// if the cache drops it meanwhile.
+	PagePtr Get(const PagedColumn& column, size_t page);
+	// like Get, but a page that is not resident is read without making it resident or making room for it,
+	// and a resident one does not become more recent; for scans that go through a whole column once
+	PagePtr Peek(const PagedColumn& column, size_t page);
+	// drops the pages of a source that is closed
+	void Forget(const PageSource& source);
+
+private:
+	PageCache() = default;
+
+	struct Key
+	{
+		uint64_t column;
+		size_t page;
+		bool operator==(const Key& other) const { return column == other.column && page == other.page; }
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const { return std::hash<uint64_t>()(key.column * 0x9E3779B97F4A7C15ull + key.page); }
+	};
+	struct Entry
+	{
+		Key key;
+		const PageSource* source;
+		PagePtr page;
+	};
+	// the page from disk; a page of NaN, with failed set, if it cannot be read
+	PagePtr Read(const PagedColumn& column, size_t page, bool& failed);
+	void Evict(); // with _mutex held
+
+	mutable std::mutex _mutex;
+	std::list<Entry> _lru;	// most recently used first
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _index;
+	std::atomic<size_t> _budget{ DefaultBudget };
+	std::atomic<size_t> _resident{ 0 };
+	std::atomic<uint64_t> _reads{ 0 };
+	std::atomic<uint64_t> _failures{ 0 };
+};
+
+namespace Paging
+{
+	// The pages a thread read last are held in a ThreadBlockCache, which keeps them readable after the
+	// PageCache drops them, so a reader takes the cache's lock once per page, not per sample. A NaN page
+	// that failed to read is held like the others: the thread reads it again only once it moved on to other
+	// pages, rather than once per sample of it.
+	typedef ThreadBlockCache<PagePtr> HeldPages;
+	const double* Page(const PagedColumn& column, size_t page);
+
+	// Calls fn(values, count) for the samples [first, last) a page at a time, the pages taken with
+	// PageCache::Peek, so a scan leaves the cache to the views. Stops and returns false when fn does.
+	template <typename Fn>
+	bool ForEachPage(const PagedColumn& column, size_t first, size_t last, Fn&& fn)
+	{
+		const size_t pageRows = size_t(1) << column.pageShift;
+		for (size_t page = first >> column.pageShift; page * pageRows < last; page++)
+		{
+			const PagePtr values = PageCache::Instance().Peek(column, page);
+			const size_t begin = std::max(first, page * pageRows);
+			const size_t end = std::min(last, (page + 1) * pageRows);
+			if (!fn(values->data() + (begin - page * pageRows), end - begin))
+				return false;
+		}
+		return true;
+	}
+
+	inline double At(const PagedColumn& column, size_t i)
+	{
+		const size_t page = i >> column.pageShift;
+		const double* values = HeldPages::Last(column.id, page);
+		return (values ? values : Page(column, page))[i & ((size_t(1) << column.pageShift) - 1)];
+	}
+}
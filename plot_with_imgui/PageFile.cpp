@@ -0,0 +1,278 @@
+#include "PageFile.h"
+#include <Windows.h>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace
+{
+    const char Magic[8] = { 'P', 'W', 'I', 'P', 'A', 'G', 'E', 'S' };
+    const uint32_t Version = 3;
+    const uint64_t DataOffset = 4096;	// the header is rewritten there once the pages are written
+    const size_t GroupBytes = size_t(64) << 20;
+    const int MinPageShift = PageFile::SummaryShift + 2;
+    const int MaxPageShift = 16;
+
+    size_t Align(size_t offset) { return (offset + sizeof(double) - 1) / sizeof(double) * sizeof(double); }
+
+    std::atomic<uint64_t> s_columnIds(0);
+}
+
+// File layout: FileHeader, padded to DataOffset, the groups of pages, then the index: one Entry per column,
+// the column names and, 8-byte aligned, the pyramids. A page of the last group is written whole.
+// checksum covers the header (with checksum = 0) and the index; the pages have none.
+struct PageFile::FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pageShift;
+    uint64_t csvSize;
+    uint64_t csvWriteTime;
+    uint64_t csvHash;
+    uint64_t rows;
+    uint64_t columns;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+    uint64_t checksum;
+};
+
+struct PageFile::Entry
+{
+    uint64_t nameOffset;	// in the index
+    uint64_t nameLength;
+    uint64_t pyramidOffset;
+    uint64_t pyramidCount;	// doubles
+    uint32_t type;
+    uint32_t monotonic;
+    uint64_t empty;			// ParseIssues
+    uint64_t invalid;
+    uint64_t firstInvalid;
+    uint64_t gaps;			// NaN samples, also those of "nan" cells, which are no issue
+};
+
+int PageFile::PageShiftFor(size_t columns)
+{
+    int shift = MaxPageShift;
+    while (shift > MinPageShift && (size_t(1) << shift) * sizeof(double) * std::max<size_t>(columns, 1) > GroupBytes)
+        shift--;
+    return shift;
+}
+
+bool PageFile::Open(const std::string& filename, const CacheKey& key)
+{
+    Close();
+    auto source = std::make_shared<PageSource>();
+    FileHeader header;
+    if (!source->Open(PathFor(filename)) || !source->Read(0, &header, sizeof(header)))
+        return false;
+    if (memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+        header.csvSize != key.size || header.csvWriteTime != key.writeTime || header.csvHash != key.hash)
+        return false;
+
+    // the pages must end where the index starts, and the index at the end of the file
+    const uint64_t pageRows = uint64_t(1) << header.pageShift;
+    const uint64_t size = source->Size();
+    if (header.pageShift < MinPageShift || header.pageShift > MaxPageShift || header.columns > size / sizeof(Entry) ||
+        header.indexOffset > size || header.indexBytes != size - header.indexOffset || header.indexBytes < header.columns * sizeof(Entry))
+        return false;
+    const uint64_t groups = (header.rows + pageRows - 1) / pageRows;
+    if (header.columns > 0 && groups > (size - DataOffset) / (header.columns * pageRows * sizeof(double)))
+        return false;
+    if (header.indexOffset != DataOffset + groups * header.columns * pageRows * sizeof(double))
+        return false;
+
+    std::vector<char> index(static_cast<size_t>(header.indexBytes));
+    if (!source->Read(header.indexOffset, index.data(), index.size()))
+        return false;
+    FileHeader copy = header;
+    copy.checksum = 0;
+    if (HashBytes(index.data(), index.size(), HashBytes(&copy, sizeof(copy))) != header.checksum)
+        return false;
+
+    const size_t columns = static_cast<size_t>(header.columns);
+    const size_t rows = static_cast<size_t>(header.rows);
+    const Entry* entries = reinterpret_cast<const Entry*>(index.data());
+    std::vector<MinMaxPyramid> pyramids(columns, MinMaxPyramid(SummaryShift));
+    _names.resize(columns);
+    _issues.resize(columns);
+    source->columns.resize(columns);
+    for (size_t col = 0; col < columns; col++)
+    {
+        const Entry& entry = entries[col];
+        if (entry.nameOffset > index.size() || entry.nameLength > index.size() - entry.nameOffset ||
+            entry.pyramidOffset % sizeof(double) != 0 || entry.pyramidOffset > index.size() ||
+            entry.pyramidCount > (index.size() - entry.pyramidOffset) / sizeof(double) ||
+            !pyramids[col].Restore(reinterpret_cast<const double*>(index.data() + entry.pyramidOffset), static_cast<size_t>(entry.pyramidCount), rows))
+        {
+            Close();
+            return false;
+        }
+        _names[col].assign(index.data() + entry.nameOffset, static_cast<size_t>(entry.nameLength));
+        _issues[col].empty = entry.empty;
+        _issues[col].invalid = entry.invalid;
+        _issues[col].firstInvalid = entry.firstInvalid;
+
+        PagedColumn& column = source->columns[col];
+        column.source = source.get();
+        column.id = ++s_columnIds;
+        column.offset = DataOffset + col * pageRows * sizeof(double);
+        column.stride = header.columns * pageRows * sizeof(double);
+        column.pageShift = static_cast<int>(header.pageShift);
+        column.size = rows;
+        // the largest sample of a page is the largest of its summary blocks
+        const size_t blocksPerPage = size_t(1) << (header.pageShift - SummaryShift);
+        column.pageMax.resize(static_cast<size_t>(groups));
+        for (size_t page = 0; page < column.pageMax.size(); page++)
+        {
+            double lo, hi = std::numeric_limits<double>::infinity();
+            if (pyramids[col].Blocks() > 0)
+                pyramids[col].BlockMinMax(page * blocksPerPage, std::min(pyramids[col].Blocks(), (page + 1) * blocksPerPage), lo, hi);
+            column.pageMax[page] = hi;
+        }
+    }
+
+    // the columns only point into the source, which they keep open
+    SampleFormat format;
+    format.type = StorageType::Paged;
+    _columns.resize(columns);
+    for (size_t col = 0; col < columns; col++)
+    {
+        _columns[col] = std::make_shared<ColumnBuffer>(&source->columns[col], rows, format, source,
+            static_cast<ColumnType>(entries[col].type), std::move(pyramids[col]), entries[col].monotonic != 0,
+            static_cast<size_t>(entries[col].gaps));
+    }
+    _source = std::move(source);
+    _rows = rows;
+    return true;
+}
+
+void PageFile::Close()
+{
+    _source.reset(); // columns handed out keep it open
+    _rows = 0;
+    _names.clear();
+    _columns.clear();
+    _issues.clear();
+}
+
+PageFile::Writer::~Writer()
+{
+    if (_out.is_open())
+    {
+        _out.close();
+        DeleteFileA(_temp.c_str());
+    }
+}
+
+bool PageFile::Writer::Create(const std::string& filename, const CacheKey& key, const std::vector<std::string>& header,
+    const std::vector<ColumnType>& types, int pageShift)
+{
+    static std::atomic<unsigned> writes(0);
+    _path = PathFor(filename);
+    _temp = _path + "." + std::to_string(++writes) + ".tmp";
+    _key = key;
+    _header = header;
+    _types = types;
+    _pageShift = pageShift;
+    _rows = 0;
+    _pyramids.assign(header.size(), MinMaxPyramid(SummaryShift));
+    _last.assign(header.size(), -std::numeric_limits<double>::infinity());
+    _monotonic.assign(header.size(), 1);
+    _gaps.assign(header.size(), 0);
+
+    _out.open(_temp, std::ios::binary | std::ios::trunc);
+    const std::vector<char> reserved(static_cast<size_t>(DataOffset), 0);
+    _out.write(reserved.data(), reserved.size());
+    return static_cast<bool>(_out);
+}
+
+bool PageFile::Writer::Add(const std::vector<std::vector<double>>& pages, size_t rows)
+{
+    const size_t pageRows = size_t(1) << _pageShift;
+    const std::vector<double> padding(pageRows - rows, 0.0);
+    for (size_t col = 0; col < pages.size(); col++)
+    {
+        const double* values = pages[col].data();
+        _out.write(reinterpret_cast<const char*>(values), rows * sizeof(double));
+        _out.write(reinterpret_cast<const char*>(padding.data()), padding.size() * sizeof(double));
+
+        // a column is sorted while no sample is smaller than the last one with a value before it
+        double last = _last[col];
+        for (size_t i = 0; i < rows && _monotonic[col]; i++)
+        {
+            if (values[i] != values[i])
+                continue;
+            _monotonic[col] = values[i] >= last;
+            last = values[i];
+        }
+        _last[col] = last;
+        for (size_t i = 0; i < rows; i++)
+            _gaps[col] += values[i] != values[i];
+        _pyramids[col].Append(values, _rows, _rows + rows);
+    }
+    _rows += rows;
+    return static_cast<bool>(_out);
+}
+
+bool PageFile::Writer::Finish(const std::vector<ParseIssues>& issues)
+{
+    FileHeader fileHeader = {};
+    memcpy(fileHeader.magic, Magic, sizeof(Magic));
+    fileHeader.version = Version;
+    fileHeader.pageShift = static_cast<uint32_t>(_pageShift);
+    fileHeader.csvSize = _key.size;
+    fileHeader.csvWriteTime = _key.writeTime;
+    fileHeader.csvHash = _key.hash;
+    fileHeader.rows = _rows;
+    fileHeader.columns = _header.size();
+    fileHeader.indexOffset = static_cast<uint64_t>(_out.tellp());
+
+    // lay out the index: entries, names, pyramids
+    std::vector<Entry> entries(_header.size());
+    std::vector<std::vector<double>> pyramids(_header.size());
+    std::string names;
+    for (size_t col = 0; col < entries.size(); col++)
+    {
+        entries[col].nameOffset = entries.size() * sizeof(Entry) + names.size();
+        entries[col].nameLength = _header[col].size();
+        names += _header[col];
+    }
+    size_t offset = Align(entries.size() * sizeof(Entry) + names.size());
+    for (size_t col = 0; col < entries.size(); col++)
+    {
+        pyramids[col] = _pyramids[col].Flatten();
+        Entry& entry = entries[col];
+        entry.pyramidOffset = offset;
+        entry.pyramidCount = pyramids[col].size();
+        offset += pyramids[col].size() * sizeof(double);
+        entry.type = static_cast<uint32_t>(_types[col]);
+        entry.monotonic = _monotonic[col] ? 1 : 0;
+        entry.empty = issues[col].empty;
+        entry.invalid = issues[col].invalid;
+        entry.firstInvalid = issues[col].firstInvalid;
+        entry.gaps = _gaps[col];
+    }
+    std::vector<char> index(offset, 0);
+    if (!entries.empty())
+        memcpy(index.data(), entries.data(), entries.size() * sizeof(Entry));
+    memcpy(index.data() + entries.size() * sizeof(Entry), names.data(), names.size());
+    for (size_t col = 0; col < entries.size(); col++)
+    {
+        if (!pyramids[col].empty())
+            memcpy(index.data() + entries[col].pyramidOffset, pyramids[col].data(), pyramids[col].size() * sizeof(double));
+    }
+    fileHeader.indexBytes = index.size();
+    fileHeader.checksum = HashBytes(index.data(), index.size(), HashBytes(&fileHeader, sizeof(fileHeader)));
+
+    _out.write(index.data(), index.size());
+    _out.seekp(0);
+    _out.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    _out.close();
+    if (!_out)
+    {
+        DeleteFileA(_temp.c_str());
+        return false;
+    }
+    return MoveFileExA(_temp.c_str(), _path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <cstdint>
+#include "ColumnCache.h"
+#include "PageCache.h"
+
+// Out-of-core storage of a CSV file's columns ("<file>.pwpages"), for recordings larger than memory.
+// The rows are stored in groups of 1 << pageShift rows, and a group holds one page of doubles per column,
+// so the file is written while the CSV is read, a group at a time, and never held whole. The columns
+// read their pages through the PageCache. Per column the file also holds a min/max pyramid with blocks
+// of 1 << SummaryShift samples, which is all of a column that stays in memory: a plot of the whole
+// recording is drawn from it (see LineLod) without reading any page.
+class PageFile
+{
+public:
+	static const int SummaryShift = 10;	// about 0.03 bytes of pyramid per sample
+	static std::string PathFor(const std::string& filename) { return filename + ".pwpages"; }
+	// rows per group for a file with that many columns, so that a group of pages stays at tens of MB
+	static int PageShiftFor(size_t columns);
+
+	// false if there is no page file for this key, or it is stale or damaged
+	bool Open(const std::string& filename, const CacheKey& key);
+	void Close();
+	bool IsOpen() const { return _source != nullptr; }
+
+	size_t Rows() const { return _rows; }
+	size_t Columns() const { return _names.size(); }
+	const std::string& Name(size_t col) const { return _names[col]; }
+	// the paged column, holding nothing in memory but its pyramid
+	std::shared_ptr<ColumnBuffer> Column(size_t col) const { return _columns[col]; }
+	const ParseIssues& Issues(size_t col) const { return _issues[col]; }
+	// bytes of the file's pages in the PageCache
+	size_t ResidentBytes() const { return _source ? _source->Resident() : 0; }
+
+	// Writes a page file through a temporary file, which replaces the page file when Finish() succeeds
+	// and is deleted otherwise.
+	class Writer
+	{
+	public:
+		~Writer();
+		bool Create(const std::string& filename, const CacheKey& key, const std::vector<std::string>& header,
+			const std::vector<ColumnType>& types, int pageShift);
+		// the next group of rows: pages[col] holds its rows samples, 1 << pageShift unless it is the last group
+		bool Add(const std::vector<std::vector<double>>& pages, size_t rows);
+		bool Finish(const std::vector<ParseIssues>& issues);
+
+	private:
+		std::ofstream _out;
+		std::string _path;
+		std::string _temp;
+		CacheKey _key;
+		std::vector<std::string> _header;
+		std::vector<ColumnType> _types;
+		int _pageShift = 0;
+		size_t _rows = 0;
+		std::vector<MinMaxPyramid> _pyramids;
+		std::vector<double> _last;		// sample of every column, for finding which ones are sorted
+		std::vector<char> _monotonic;
+		std::vector<uint64_t> _gaps;	// NaN samples of every column
+	};
+
+private:
+	struct FileHeader;
+	struct Entry;
+
+	std::shared_ptr<PageSource> _source;
+	size_t _rows = 0;
+	std::vector<std::string> _names;
+	std::vector<std::shared_ptr<ColumnBuffer>> _columns;
+	std::vector<ParseIssues> _issues;
+};
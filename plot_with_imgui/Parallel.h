@@ -0,0 +1,25 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+inline unsigned WorkerCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Runs fn(task) for task = 0..tasks-1, each on its own thread; task 0 runs on the calling thread.
+template <typename Fn>
+void ParallelFor(size_t tasks, Fn&& fn)
+{
+	if (tasks == 0)
+		return;
+
+	std::vector<std::thread> threads;
+	threads.reserve(tasks - 1);
+	for (size_t task = 1; task < tasks; task++)
+		threads.emplace_back([&fn, task]() { fn(task); });
+	fn(size_t(0));
+	for (auto& thread : threads)
+		thread.join();
+}
@@ -1,5 +1,7 @@
 #include "Plot.h"
 #include "PlotApp.h"
+#include "../implot/implot_internal.h"
+#include "Timestamp.h"
 #include <Windows.h>
 #include <iostream>
 #include <algorithm>
@@ -8,11 +10,6 @@
 #define __STDC_LIB_EXT1__
 #include "../stb/stb_image_write.h"
 
-#ifdef max
-#undef max
-#undef min
-#endif
-
 int Plot::Counter = 0;
 
 const char* MarkerNameGetter(void* user_data, int idx)
@@ -20,12 +17,116 @@ const char* MarkerNameGetter(void* user_data, int idx)
     return ImPlot::GetMarkerName(idx);
 }
 
+// X column of col if it can be binary searched, null if col is plotted against the sample index
+static const ColumnBuffer* SortedX(const Column& col)
+{
+    return col.x && col.x->Monotonic() ? col.x.get() : nullptr;
+}
+
+static double SampleX(const Column& col, size_t i)
+{
+    return col.x ? (*col.x)[i] : static_cast<double>(i);
+}
+
+// smallest and largest X of col's samples, from the pyramid of its X column (gaps left out)
+static void XRange(const Column& col, double& lo, double& hi)
+{
+    if (col.x)
+        col.x->MinMax(0, col.x->Size(), lo, hi);
+    else
+    {
+        lo = 0;
+        hi = static_cast<double>(col.data->Size()) - 1;
+    }
+}
+
+static bool TimeX(const Column& col)
+{
+    const ColumnBuffer* x = col.histogram ? col.data.get() : col.x.get();
+    return x && x->Type() == ColumnType::Time;
+}
+
+static void FormatX(const Column& col, double x, char* buffer, size_t size)
+{
+    if (TimeX(col))
+        FormatTimestamp(x, buffer, size);
+    else
+        snprintf(buffer, size, "%g", x);
+}
+
+// ImPlot getter over samples in their stored type, see ColumnBuffer::Visit
+template <typename YSamples, typename XSamples>
+struct SampleGetter
+{
+    YSamples ys;
+    XSamples xs;
+    size_t first;
+
+    static ImPlotPoint Get(int idx, void* user)
+    {
+        const SampleGetter& getter = *static_cast<const SampleGetter*>(user);
+        const size_t i = getter.first + idx;
+        return ImPlotPoint(getter.xs[i], getter.ys[i]);
+    }
+};
+
+// Plots data[first, last) against xs, or the sample index if xs is null, as a line or as markers. Doubles
+// go to ImPlot as arrays, narrow formats through a getter that reads them directly.
+static void PlotSamples(const char* label, const ColumnBuffer& data, const ColumnBuffer* xs, size_t first, size_t last, bool markers)
+{
+    const int count = static_cast<int>(last - first);
+    if (data.Data() && (!xs || xs->Data()))
+    {
+        if (xs && markers)
+            ImPlot::PlotScatter(label, xs->Data() + first, data.Data() + first, count);
+        else if (xs)
+            ImPlot::PlotLine(label, xs->Data() + first, data.Data() + first, count);
+        else if (markers)
+            ImPlot::PlotScatter(label, data.Data() + first, count, 1.0, static_cast<double>(first));
+        else
+            ImPlot::PlotLine(label, data.Data() + first, count, 1.0, static_cast<double>(first));
+        return;
+    }
+
+    data.Visit([&](const auto& ys) {
+        auto plot = [&](const auto& xv) {
+            SampleGetter<std::decay_t<decltype(ys)>, std::decay_t<decltype(xv)>> getter = { ys, xv, first };
+            if (markers)
+                ImPlot::PlotScatterG(label, &decltype(getter)::Get, &getter, count);
+            else
+                ImPlot::PlotLineG(label, &decltype(getter)::Get, &getter, count);
+        };
+        if (xs)
+            xs->Visit(plot);
+        else
+            plot(IndexSamples());
+        });
+}
+
+// sample of col nearest to (x, y) in pixels, col.data->Size() if none: searched with the pyramid, or with
+// the column's ScatterIndex when its X is not sorted
+static size_t NearestSample(Column& col, double x, double y, double sx, double sy, double& dist2)
+{
+    if (col.x && !col.x->Monotonic())
+        return col.index.Nearest(col.data, col.x, x, y, sx, sy, dist2);
+    return col.data->Nearest(col.x.get(), x, y, sx, sy, dist2);
+}
+
+// pixels per plot unit of the current plot, for nearest point searches
+static void PixelScale(double& sx, double& sy)
+{
+    ImPlotRect limits = ImPlot::GetPlotLimits();
+    ImVec2 plotSize = ImPlot::GetPlotSize();
+    sx = plotSize.x / limits.X.Size();
+    sy = plotSize.y / limits.Y.Size();
+}
+
 void Plot::Draw()
 {
     _cursorPos = ImGui::GetCursorPos();
     _extents = ImGui::GetContentRegionAvail();
 
-    if (ImPlot::BeginPlot("My Title##Plot", _extents))
+    if (ImPlot::BeginPlot("My Title##Plot", _extents, _hoverReadout ? ImPlotFlags_Crosshairs : ImPlotFlags_None))
     {
         if (!_initialized)
         {
@@ -33,6 +134,11 @@ void Plot::Draw()
             ImPlot::SetupLegend(ImPlotLocation_NorthWest, ImPlotLegendFlags_Markers);
             _initialized = true;
         }
+        // time columns hold seconds since the epoch, which the time axis labels as dates and times
+        if (std::any_of(_columns.begin(), _columns.end(), TimeX))
+            ImPlot::SetupAxisScale(ImAxis_X1, ImPlotScale_Time);
+        if (_autoScroll)
+            SetupScroll();
 
         int deleteAnnotationIdx = -1;
 
@@ -64,7 +170,7 @@ void Plot::Draw()
             else if (clicked && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
             {
                 ImGui::OpenPopup("Annotation_PopUp");
-                _currAnnotation = &vec;
+                _currAnnotation = i;
             }
             else if (hovered && ImGui::IsMouseClicked(ImGuiMouseButton_Middle))
             {
@@ -73,12 +179,24 @@ void Plot::Draw()
         }
 
         if (deleteAnnotationIdx >= 0)
+        {
             _annotations.erase(_annotations.begin() + deleteAnnotationIdx);
+            if (_currAnnotation == deleteAnnotationIdx)
+                _currAnnotation = -1;
+            else if (_currAnnotation > deleteAnnotationIdx)
+                _currAnnotation--;
+        }
 
         if (ImGui::BeginPopup("Annotation_PopUp"))
         {
-            ImGui::SeparatorText(_currAnnotation->label);
-            ImGui::InputTextMultiline("##Annotation", _currAnnotation->text, sizeof(_currAnnotation->text));
+            if (_currAnnotation >= 0)
+            {
+                auto& anno = _annotations[_currAnnotation];
+                ImGui::SeparatorText(anno.label);
+                ImGui::InputTextMultiline("##Annotation", anno.text, sizeof(anno.text));
+            }
+            else
+                ImGui::CloseCurrentPopup();
             ImGui::EndPopup();
         }
         else if (ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows))
@@ -96,13 +214,21 @@ void Plot::Draw()
                         ImGui::SliderFloat("Thickness", &col.thickness, 0, 5);
                     }
                     ImGui::Combo("Marker Type", &col.marker, &MarkerNameGetter, nullptr, ImPlotMarker_COUNT);
+                    if (!col.line)
+                        ImGui::InputInt("Density above", &col.density_threshold, 10000, 100000);
                 }
                 else
                 {
                     ImGui::Checkbox("Cumulative", &col.cumulative);
                     ImGui::Checkbox("Density", &col.density);
                     ImGui::Checkbox("Remove Outliers", &col.no_outliers);
-                    ImGui::SliderInt("Bins", &col.bins, 2, static_cast<int>(col.ys.size() / 2));
+                    ImGui::SliderInt("Bins", &col.bins, 2, static_cast<int>(col.data->Size() / 2));
+                    ImGui::Text("Rebin: %.1f ms, %.2f GB/s", col.hist.RebinSeconds() * 1e3, col.hist.RebinBytesPerSecond() / 1e9);
+                    if (col.hist.Scanning() >= 0)
+                        ImGui::Text("Scanning the whole file: %.0f%%", col.hist.Scanning() * 100);
+                    const ColumnStats& stats = col.hist.Stats();
+                    ImGui::Text("Values: %zu, missing: %zu", stats.count, col.data->Size() - stats.count);
+                    ImGui::Text("Mean: %g, std: %g", stats.mean, stats.stddev);
                 }
                 if (col.marker != ImPlotMarker_None || col.histogram)
                     ImGui::SliderFloat("Fill", &col.alpha, 0, 1, "%.2f");
@@ -111,8 +237,8 @@ void Plot::Draw()
                     if (ImGui::Button("Histogram"))
                     {
                         Plot histogram;
-                        histogram.AddCol(col.label_id, col.ys, col.color, true);
-                        PlotApp::Instance().AddPlot(histogram);
+                        histogram.AddCol(col.label_id, col.data, nullptr, col.color, true);
+                        PlotApp::Instance().AddPlot(std::move(histogram));
                     }
                 }
                 ImPlot::EndLegendPopup();
@@ -131,20 +257,19 @@ void Plot::Draw()
             if (col.histogram)
             {
                 ImPlot::SetNextFillStyle(col.color, col.alpha);
-                ImPlotHistogramFlags flags = 0;
-                if (col.cumulative) flags |= ImPlotHistogramFlags_Cumulative;
-                if (col.density) flags |= ImPlotHistogramFlags_Density;
-                if (col.no_outliers) flags |= ImPlotHistogramFlags_NoOutliers;
-                ImPlot::PlotHistogram(col.label_id.c_str(), col.ys.data(), static_cast<int>(col.ys.size()), col.bins, 1.0,
-                    ImPlotRange(), flags);
+                col.hist.Update(col.data, col.bins, col.cumulative, col.density, col.no_outliers);
+                ImPlot::PlotBars(col.label_id.c_str(), col.hist.Centers(), col.hist.Counts(), col.hist.Bins(), col.hist.BinWidth());
             }
             else if (!col.line)
-                ImPlot::PlotScatter(col.label_id.c_str(), col.ys.data(), static_cast<int>(col.ys.size()));
+                PlotScatter(col);
             else
-                ImPlot::PlotLine(col.label_id.c_str(), col.ys.data(), static_cast<int>(col.ys.size()));
+                PlotLine(col);
 
         }
 
+        if (_hoverReadout && ImPlot::IsPlotHovered())
+            ShowReadout();
+
         if (ImGui::BeginDragDropTarget()) {
             if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("ColDragAndDrop")) {
                 int i = *(int*)payload->Data; 
@@ -157,6 +282,135 @@ void Plot::Draw()
     }
 }
 
+// X ends at the newest sample and keeps the span, Y fits the samples inside it (found with the pyramids)
+void Plot::SetupScroll()
+{
+    double end = -std::numeric_limits<double>::infinity();
+    for (const auto& col : _columns)
+    {
+        if (!col.histogram && col.data->Size() > 0)
+        {
+            double lo, hi;
+            XRange(col, lo, hi);
+            end = std::max(end, hi);
+        }
+    }
+    if (end == -std::numeric_limits<double>::infinity())
+        return;
+    const double begin = end - _scrollSpan;
+    ImPlot::SetupAxisLimits(ImAxis_X1, begin, end, ImPlotCond_Always);
+
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    for (const auto& col : _columns)
+    {
+        const size_t size = col.data->Size();
+        if (col.histogram || !col.show || size == 0 || (col.x && !SortedX(col)))
+            continue;
+        const ColumnBuffer* xs = SortedX(col);
+        const size_t first = xs ? xs->LowerBound(begin) : static_cast<size_t>(std::clamp(std::ceil(begin), 0.0, static_cast<double>(size)));
+        double colLo, colHi;
+        col.data->MinMax(first, size, colLo, colHi);
+        lo = std::min(lo, colLo);
+        hi = std::max(hi, colHi);
+    }
+    if (lo <= hi)
+    {
+        const double margin = std::max((hi - lo) * 0.05, 1e-9 * std::max(1.0, std::abs(hi)));
+        ImPlot::SetupAxisLimits(ImAxis_Y1, lo - margin, hi + margin, ImPlotCond_Always);
+    }
+}
+
+void Plot::PlotLine(Column& col)
+{
+    const size_t size = col.data->Size();
+    const ColumnBuffer* xs = SortedX(col);
+    if (size == 0 || (col.x && !xs))
+    {
+        // without an order on X there is no visible range to cut out
+        if (col.x)
+            PlotSamples(col.label_id.c_str(), *col.data, col.x.get(), 0, size, false);
+        return;
+    }
+
+    // while the X axis is being fitted, the whole column has to be submitted so the fit sees all of it
+    double xMin, xMax;
+    XRange(col, xMin, xMax);
+    if (!ImPlot::GetCurrentPlot()->Axes[ImAxis_X1].FitThisFrame)
+    {
+        ImPlotRect limits = ImPlot::GetPlotLimits();
+        xMin = limits.X.Min;
+        xMax = limits.X.Max;
+    }
+
+    if (col.lod.Update(*col.data, xs, xMin, xMax, static_cast<int>(ImPlot::GetPlotSize().x)))
+        ImPlot::PlotLine(col.label_id.c_str(), col.lod.Xs(), col.lod.Ys(), col.lod.Count());
+    else
+        PlotSamples(col.label_id.c_str(), *col.data, xs, col.lod.First(), col.lod.Last(), false);
+}
+
+void Plot::PlotScatter(Column& col)
+{
+    const size_t size = col.data->Size();
+    if (size == 0)
+        return;
+
+    // without an order on X any sample can be in view, and the density image bins all of them
+    const ColumnBuffer* xs = SortedX(col);
+    const bool unsorted = col.x && !xs;
+    ImPlotPlot* plot = ImPlot::GetCurrentPlot();
+    ImPlotRect limits = ImPlot::GetPlotLimits();
+    size_t first, last;
+    if (unsorted)
+    {
+        first = 0;
+        last = size;
+    }
+    else if (xs)
+    {
+        first = xs->LowerBound(limits.X.Min);
+        last = xs->UpperBound(limits.X.Max);
+    }
+    else
+    {
+        first = static_cast<size_t>(std::clamp(std::floor(limits.X.Min), 0.0, static_cast<double>(size)));
+        last = static_cast<size_t>(std::clamp(std::ceil(limits.X.Max) + 1, 0.0, static_cast<double>(size)));
+    }
+
+    if (last - first <= static_cast<size_t>(std::max(0, col.density_threshold)))
+    {
+        PlotSamples(col.label_id.c_str(), *col.data, col.x.get(), first, last, true);
+    }
+    else if (plot->Axes[ImAxis_X1].FitThisFrame || plot->Axes[ImAxis_Y1].FitThisFrame)
+    {
+        // an image does not tell the fit where the data is; the min/max summary has the same extents
+        double xMin, xMax;
+        XRange(col, xMin, xMax);
+        if (unsorted)
+        {
+            // the corners of the samples' bounding box, from the pyramids; the image follows once fitted
+            double yMin, yMax;
+            col.data->MinMax(0, size, yMin, yMax);
+            if (xMin <= xMax && yMin <= yMax)
+            {
+                ImPlot::FitPoint(ImPlotPoint(xMin, yMin));
+                ImPlot::FitPoint(ImPlotPoint(xMax, yMax));
+            }
+        }
+        else if (col.lod.Update(*col.data, xs, xMin, xMax, static_cast<int>(ImPlot::GetPlotSize().x)))
+            ImPlot::PlotScatter(col.label_id.c_str(), col.lod.Xs(), col.lod.Ys(), col.lod.Count());
+        else
+            PlotSamples(col.label_id.c_str(), *col.data, xs, 0, size, true);
+    }
+    else
+    {
+        ImVec2 plotSize = ImPlot::GetPlotSize();
+        ImTextureID texture = col.raster.Update(*col.data, col.x.get(), first, last, limits, static_cast<int>(plotSize.x), static_cast<int>(plotSize.y),
+            ImVec4(col.color.x, col.color.y, col.color.z, 1.0f), ImPlot::GetStyle().MarkerSize);
+        ImPlot::PlotImage(col.label_id.c_str(), texture, ImPlotPoint(limits.X.Min, limits.Y.Min), ImPlotPoint(limits.X.Max, limits.Y.Max));
+    }
+}
+
 void Plot::HandleKeyPressed()
 {
     if (ImGui::IsKeyPressed(ImGuiKey_D))
@@ -164,6 +418,15 @@ void Plot::HandleKeyPressed()
         AddDataTip();
     }
 
+    if (ImGui::IsKeyPressed(ImGuiKey_H))
+        _hoverReadout = !_hoverReadout;
+
+    if (ImGui::IsKeyPressed(ImGuiKey_F))
+    {
+        _autoScroll = !_autoScroll;
+        _scrollSpan = ImPlot::GetPlotLimits().X.Size();
+    }
+
     if (ImGui::IsKeyPressed(ImGuiKey_I))
     {
         for (auto& col : _columns)
@@ -188,34 +451,92 @@ void Plot::HandleKeyPressed()
 
 void Plot::AddDataTip()
 {
-    auto mousePos = ImGui::GetMousePos();
+    // distances are measured in pixels, the way the user sees the plot
+    double sx, sy;
+    PixelScale(sx, sy);
+    ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+
     double dist = std::numeric_limits<double>::max();
-    Annotation anno;
+    int nearestCol = -1;
+    size_t nearest = 0;
     for (int col = 0; col < _columns.size(); col++)
     {
-        if (_columns[col].show)
+        if (_columns[col].show && !_columns[col].histogram)
         {
-            for (int i = 0; i < _columns[col].ys.size(); i++)
+            double currDist;
+            size_t i = NearestSample(_columns[col], mouse.x, mouse.y, sx, sy, currDist);
+            if (i < _columns[col].data->Size() && currDist < dist)
             {
-                ImPlotPoint point(i, _columns[col].ys[i]);
-                ImVec2 pointPixel = ImPlot::PlotToPixels(point);
-                double currDist = (pointPixel.x - mousePos.x) * (pointPixel.x - mousePos.x) + (pointPixel.y - mousePos.y) * (pointPixel.y - mousePos.y);
-                if (currDist < dist)
-                {
-                    dist = currDist;
-                    anno.point = point;
-                    anno.color = ImPlot::GetColormapColor(col);
-                    anno.offset = ImVec2(mousePos.x - pointPixel.x, mousePos.y - pointPixel.y);
-                    sprintf_s(anno.label, sizeof(anno.text), "%s\n%g,%g", _columns[col].label_id.c_str(), anno.point.x, anno.point.y);
-                    sprintf_s(anno.text, sizeof(anno.text), "%s\n%g,%g", _columns[col].label_id.c_str(), anno.point.x, anno.point.y);
-                }
+                dist = currDist;
+                nearestCol = col;
+                nearest = i;
             }
         }
     }
+    if (nearestCol < 0)
+        return;
 
+    auto mousePos = ImGui::GetMousePos();
+    Annotation anno;
+    anno.point = ImPlotPoint(SampleX(_columns[nearestCol], nearest), (*_columns[nearestCol].data)[nearest]);
+    ImVec2 pointPixel = ImPlot::PlotToPixels(anno.point);
+    anno.color = ImPlot::GetColormapColor(nearestCol);
+    anno.offset = ImVec2(mousePos.x - pointPixel.x, mousePos.y - pointPixel.y);
+    char x[64];
+    FormatX(_columns[nearestCol], anno.point.x, x, sizeof(x));
+    sprintf_s(anno.label, sizeof(anno.text), "%s\n%s,%g", _columns[nearestCol].label_id.c_str(), x, anno.point.y);
+    sprintf_s(anno.text, sizeof(anno.text), "%s\n%s,%g", _columns[nearestCol].label_id.c_str(), x, anno.point.y);
     _annotations.push_back(anno);
 }
 
+void Plot::ShowReadout()
+{
+    double sx, sy;
+    PixelScale(sx, sy);
+    ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+
+    // nearest sample of every visible column, marked on the plot and listed in a tooltip; a column against
+    // an unsorted X is listed as indexing until its ScatterIndex is built, instead of being scanned
+    std::vector<std::pair<int, ImPlotPoint>> points;
+    std::vector<int> indexing;
+    for (int col = 0; col < _columns.size(); col++)
+    {
+        Column& column = _columns[col];
+        if (!column.show || column.histogram)
+            continue;
+        double dist2;
+        size_t i = NearestSample(column, mouse.x, mouse.y, sx, sy, dist2);
+        if (i < column.data->Size())
+            points.push_back({ col, ImPlotPoint(SampleX(column, i), (*column.data)[i]) });
+        else if (column.index.Building())
+            indexing.push_back(col);
+    }
+    if (points.empty() && indexing.empty())
+        return;
+
+    ImDrawList* drawList = ImPlot::GetPlotDrawList();
+    ImPlot::PushPlotClipRect();
+    for (auto& point : points)
+        drawList->AddCircle(ImPlot::PlotToPixels(point.second), 4.0f, ImGui::GetColorU32(_columns[point.first].color), 0, 1.5f);
+    ImPlot::PopPlotClipRect();
+
+    ImGui::BeginTooltip();
+    const float swatch = ImGui::GetTextLineHeight();
+    for (auto& point : points)
+    {
+        ImGui::PushID(point.first);
+        ImGui::ColorButton("##color", _columns[point.first].color, ImGuiColorEditFlags_NoTooltip, ImVec2(swatch, swatch));
+        ImGui::SameLine();
+        char x[64];
+        FormatX(_columns[point.first], point.second.x, x, sizeof(x));
+        ImGui::Text("%s: %s, %g", _columns[point.first].label_id.c_str(), x, point.second.y);
+        ImGui::PopID();
+    }
+    for (int col : indexing)
+        ImGui::TextDisabled("%s: indexing the unsorted X...", _columns[col].label_id.c_str());
+    ImGui::EndTooltip();
+}
+
 // Helper function to convert BGRA to RGBA
 void Plot::ConvertBGRAtoRGBA(void* data, int width, int height) {
     unsigned char* pixels = static_cast<unsigned char*>(data);
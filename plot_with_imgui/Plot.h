@@ -2,17 +2,18 @@
 #include <vector>
 #include <string>
 #include "../implot/implot.h"
+#include "ColumnBuffer.h"
+#include "Decimation.h"
+#include "DensityRaster.h"
+#include "Histogram.h"
+#include "ScatterIndex.h"
 #include <limits>
 
-#ifdef max
-#undef max
-#undef min
-#endif
-
 struct Column
 {
 	std::string label_id;
-	std::vector<double> ys;
+	ColumnBufferPtr data;	// shared with the Dataset and every other view of the channel
+	ColumnBufferPtr x;		// X column from the same file, null to plot against the sample index
 	ImVec4 color;
 	float alpha;
 	ImPlotMarker marker;
@@ -26,6 +27,12 @@ struct Column
 	bool density;
 	bool no_outliers;
 	int bins;
+
+	LineLod lod;
+	DensityRaster raster;
+	int density_threshold = 200000;	// scatter turns into a density image above this many visible points
+	HistogramCache hist;
+	ScatterIndex index;	// nearest sample searches against an unsorted X
 };
 
 struct Annotation
@@ -46,12 +53,24 @@ public:
 		sprintf_s(_name, "Figure %d", Counter);
 		_open = true;
 		_initialized = false;
+		_currAnnotation = -1;
+		_hoverReadout = true;
+		_autoScroll = false;
+		_scrollSpan = 0;
 	}
-	void AddCol(std::string name, std::vector<double> ys, ImVec4 color = ImVec4(0,0,0,-1), bool histogram = false) 
+	Plot(Plot&&) = default;
+	Plot& operator=(Plot&&) = default;
+	Plot(const Plot&) = delete;
+	Plot& operator=(const Plot&) = delete;
+
+	void AddCol(std::string name, ColumnBufferPtr data, ColumnBufferPtr x = nullptr, ImVec4 color = ImVec4(0,0,0,-1), bool histogram = false) 
 	{ 
-		_columns.push_back({name, ys, color.w == -1 ? ImPlot::GetColormapColor(static_cast<int>(_columns.size())) : color,
-			0.5f, ImPlotMarker_Circle,	1.0f, false, true, histogram, false, false, false, (int)ceil(1.0 + log2((double)ys.size())) });
+		const size_t count = data->Size();
+		_columns.push_back({name, std::move(data), std::move(x), color.w == -1 ? ImPlot::GetColormapColor(static_cast<int>(_columns.size())) : color,
+			0.5f, ImPlotMarker_Circle,	1.0f, false, true, histogram, false, false, false, (int)ceil(1.0 + log2((double)std::max<size_t>(count, 1))) });
 	}
+	// X follows the newest samples over a span of X units
+	void AutoScroll(double span) { _autoScroll = true; _scrollSpan = span; }
 	void HandleKeyPressed();
 	void AddDataTip();
 	void Draw();
@@ -60,6 +79,10 @@ public:
 	const char* Name() { return _name; }
 
 private:
+	void PlotLine(Column& col);
+	void PlotScatter(Column& col);
+	void ShowReadout();
+	void SetupScroll();
 	void ConvertBGRAtoRGBA(void* data, int width, int height);
 	void CopyToClipboard(void* data, int width, int height, std::string filePath);
 	void WriteDIBToClipboard(int width, int height, void* data);
@@ -72,7 +95,10 @@ private:
 	bool _open;
 	bool _initialized;
     std::vector<Annotation> _annotations;
-	Annotation* _currAnnotation;
+	int _currAnnotation;	// index in _annotations of the one being edited, -1 for none
+	bool _hoverReadout;		// crosshair with the nearest sample of every column under the mouse, toggled with H
+	bool _autoScroll;		// X follows the newest samples of growing columns, toggled with F
+	double _scrollSpan;		// X span shown while auto-scrolling, the one visible when it was turned on
 	ImVec2 _cursorPos;
 	ImVec2 _extents;
 
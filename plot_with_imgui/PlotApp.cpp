@@ -7,9 +7,8 @@
 #include <set>
 #include <map>
 #include <vector>
-#include <fstream>
 #include <algorithm>
-#include <sstream>
+#include <cstdio>
 #include "Plot.h"
 
 
@@ -25,6 +24,12 @@ PlotApp::PlotApp()
     _show_demo_window_imgui = true;
     _show_demo_window_implot = true;
     _show_main_window = true;
+    _show_benchmark_window = false;
+    _show_live_window = false;
+    snprintf(_sharedName, sizeof(_sharedName), "%s", SharedSegment::DefaultName);
+    _sharedFailed = false;
+    _outOfCore = false;
+    _pageBudgetMB = static_cast<int>(PageCache::DefaultBudget >> 20);
     _currentFileIndex = 0;
     _lastSelectedField = -1;
 }
@@ -71,38 +76,105 @@ LRESULT WINAPI PlotApp::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lPara
 }
 
 
-std::string trimQuotes(const std::string& str) {
-    size_t first = str.find_first_not_of('"');
-    if (first == std::string::npos) {
-        return ""; // No non-quote characters found
-    }
-    size_t last = str.find_last_not_of('"');
-    return str.substr(first, last - first + 1);
+void PlotApp::LoadCSV(const std::string& filename)
+{
+    File file;
+    file.name = filename;
+    file.loading = _loads.Add(filename, _outOfCore ? Dataset::LoadMode::Paged : Dataset::LoadMode::Auto);
+    _files.push_back(std::move(file));
 }
 
-
-File PlotApp::LoadCSV(const std::string& filename)
+void PlotApp::UpdateLoads()
 {
-    File data;
-    data.name = filename;
-    std::ifstream file(filename);
-    std::string line;
-
-    while (std::getline(file, line)) {
-        std::stringstream lineStream(line);
-        std::string cell;
-        std::vector<std::string> row;
-
-        while (std::getline(lineStream, cell, ',')) {
-            row.push_back(trimQuotes(cell));
+    for (size_t fileIdx = 0; fileIdx < _files.size();)
+    {
+        File& file = _files[fileIdx];
+        if (!file.loading || !file.loading->finished)
+        {
+            fileIdx++;
+            continue;
+        }
+        if (!file.loading->columns.empty())
+        {
+            // parsed, failed or cancelled, the dataset goes back to the file; its plots get the columns that were parsed
+            file.error = file.loading->loaded || file.loading->progress.Cancelled() ? std::string() :
+                "columns could not be parsed: the file changed or was removed since it was loaded";
+            // following waits for every column; it would only queue the same parse again
+            if (!file.loading->loaded)
+                file.follow = false;
+            file.data = std::move(file.loading->data);
+            file.loading.reset();
+            for (const auto& waiting : file.waiting)
+            {
+                if (Plot* plot = _plots.Find(waiting.first))
+                    AddParsedCol(file, waiting.second, *plot);
+            }
+            file.waiting.clear();
+            fileIdx++;
+            continue;
+        }
+        if (file.loading->loaded)
+        {
+            file.data = std::move(file.loading->data);
+            file.loading.reset();
+            fileIdx++;
+            continue;
+        }
+        if (!file.loading->progress.Cancelled())
+        {
+            // stays listed, without columns, so the failure does not go unnoticed
+            file.error = "could not be loaded: the file is missing, unreadable, empty or has no header";
+            file.loading.reset();
+            fileIdx++;
+            continue;
         }
+        RemoveFile(fileIdx);
+    }
+}
 
-        data.content.push_back(row);
+void PlotApp::RemoveFile(size_t fileIdx)
+{
+    _files.erase(_files.begin() + fileIdx);
+    if (_currentFileIndex == fileIdx)
+    {
+        _selectedFields.clear();
+        _lastSelectedField = -1;
     }
+    else if (_currentFileIndex > fileIdx)
+        _currentFileIndex--;
+}
 
-    return data;
+void PlotApp::ParseLazyColumns(File& file, std::vector<size_t> cols)
+{
+    cols.erase(std::remove_if(cols.begin(), cols.end(), [&](size_t col) { return file.data.Materialized(col); }), cols.end());
+    if (!cols.empty() && !file.loading)
+        file.loading = _loads.Add(std::move(file.data), std::move(cols));
 }
 
+void PlotApp::FollowFiles()
+{
+    static const auto Interval = std::chrono::milliseconds(100);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - _lastFollow < Interval)
+        return;
+    _lastFollow = now;
+    for (File& file : _files)
+    {
+        if (!file.follow || file.loading || file.data.Paged())
+            continue;
+        // a lazily loaded file is parsed completely in the background first, and followed once it is
+        if (file.data.MaterializedColumns() < file.data.Columns())
+        {
+            std::vector<size_t> all(file.data.Columns());
+            for (size_t col = 0; col < all.size(); col++)
+                all[col] = col;
+            ParseLazyColumns(file, std::move(all));
+        }
+        else
+            file.data.Follow();
+    }
+}
 
 int PlotApp::MainLoop()
 {
@@ -198,13 +270,17 @@ int PlotApp::MainLoop()
                 {
                     char filename[256];
                     DragQueryFileA(hdrop, i, filename, 256);
-                    _files.push_back(LoadCSV(filename));
+                    LoadCSV(filename);
                 }
 
             }
         }
         if (done)
             break;
+        UpdateLoads();
+        FollowFiles();
+        _live.Drain();
+        _shared.Drain();
 
         // Handle window resize (we don't resize directly in the WM_SIZE handler)
         if (_ResizeWidth != 0 && _ResizeHeight != 0)
@@ -226,6 +302,10 @@ int PlotApp::MainLoop()
             ImGui::ShowDemoWindow(&_show_demo_window_imgui);
         if (_show_main_window)
             ShowMainWindow();
+        if (_show_benchmark_window)
+            _benchmark.Show(&_show_benchmark_window, _currentFileIndex < _files.size() ? _files[_currentFileIndex].name : std::string());
+        if (_show_live_window)
+            ShowLiveWindow();
 
         if (!_show_demo_window_imgui && !_show_demo_window_implot && !_show_main_window)
             PostMessage(hwnd, WM_CLOSE, 0, 0);
@@ -245,6 +325,8 @@ int PlotApp::MainLoop()
         }
 
         _pSwapChain->Present(1, 0); // Present with vsync
+        FreeReleasedTextures();
+        _shared.FrameShown();
         //g_pSwapChain->Present(0, 0); // Present without vsync
     }
 
@@ -254,6 +336,7 @@ int PlotApp::MainLoop()
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
 
+    FreeReleasedTextures();
     CleanupDeviceD3D();
     ::DestroyWindow(hwnd);
     ::UnregisterClassW(wc.lpszClassName, wc.hInstance);
@@ -266,29 +349,34 @@ void PlotApp::ShowMainWindow()
     ImGui::Begin("DragFilesHere", &_show_main_window);
     DragAcceptFiles((HWND)ImGui::GetWindowViewport()->PlatformHandleRaw, true);
 
-    for (auto& plot : _plots)
-    {
+    _plots.ForEach([](Plot& plot) {
+        ImGui::SetNextWindowSize(ImVec2(800, 600), ImGuiCond_FirstUseEver);
         if (ImGui::Begin(plot.Name(), plot.IsOpen(), ImGuiWindowFlags_NoSavedSettings))
             plot.Draw();
         ImGui::End();
-    }
+        });
 
     if (ImGui::Button("PLOT") && _currentFileIndex >= 0 && _currentFileIndex < _files.size() &&
-        !_selectedFields.empty())
+        !_files[_currentFileIndex].loading && !_selectedFields.empty())
     {
-        Plot plot;
-        for (auto field : _selectedFields)
-        {
-            AddColToPlot(field, plot);
-        }
-        _plots.emplace_back(plot);
-        ImGui::SetNextWindowSize(ImVec2(800, 600));
-        if (ImGui::Begin(plot.Name(), plot.IsOpen(), ImGuiWindowFlags_NoSavedSettings))
-            plot.Draw();
-        ImGui::End();
+        Plot* plot = _plots.Find(AddPlot(Plot()));
+        AddColsToPlot(_files[_currentFileIndex], std::vector<int>(_selectedFields.begin(), _selectedFields.end()), *plot);
+    }
+
+    ImGui::SameLine();
+    ImGui::Checkbox("Benchmark", &_show_benchmark_window);
+    ImGui::SameLine();
+    ImGui::Checkbox("Live", &_show_live_window);
+    // files too large for memory are read from a page file; Auto switches to it by itself for the largest
+    ImGui::SameLine();
+    ImGui::Checkbox("Out of core", &_outOfCore);
+    if (ImGui::InputInt("Page budget [MB]", &_pageBudgetMB, 256, 1024))
+    {
+        _pageBudgetMB = std::max(_pageBudgetMB, 16);
+        PageCache::Instance().SetBudget(size_t(_pageBudgetMB) << 20);
     }
 
-    _plots.erase(std::remove_if(_plots.begin(), _plots.end(), [](auto plot) {return !*plot.IsOpen(); }), _plots.end());
+    _plots.Update();
     ImGui::Spacing();
 
     CreateLists();
@@ -296,13 +384,114 @@ void PlotApp::ShowMainWindow()
     ImGui::End();
 }
 
+void PlotApp::ShowLiveWindow()
+{
+    ImGui::SetNextWindowSize(ImVec2(440, 320), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Live", &_show_live_window))
+    {
+        ImGui::End();
+        return;
+    }
+
+    // every signal against the time, scrolling over the window
+    auto plotChannels = [&](const auto& source, double span) {
+        Plot plot;
+        for (size_t channel = 1; channel < source.Channels(); channel++)
+            plot.AddCol(source.Name(channel), source.Column(channel), source.Column(0));
+        plot.AutoScroll(span);
+        AddPlot(std::move(plot));
+    };
+
+    int capacity = static_cast<int>(_liveSettings.capacity);
+    if (ImGui::InputInt("Window [samples]", &capacity, 1024, 65536))
+        _liveSettings.capacity = static_cast<size_t>(std::max(1, capacity));
+
+    ImGui::SeparatorText("Generator");
+    const bool running = _live.Running();
+    ImGui::BeginDisabled(running);
+    ImGui::InputInt("Channels", &_liveSettings.channels);
+    if (ImGui::InputDouble("Samples/s per channel", &_liveSettings.rate, 0, 0, "%.0f"))
+        _liveSettings.rate = LiveSource::Settings::ClampRate(_liveSettings.rate);
+    ImGui::EndDisabled();
+
+    if (ImGui::Button(running ? "Stop" : "Start"))
+    {
+        if (running)
+            _live.Stop();
+        else
+            _live.Start(_liveSettings);
+    }
+    if (_live.Channels() > 0)
+    {
+        ImGui::SameLine();
+        if (ImGui::Button("Plot##generator"))
+            plotChannels(_live, _live.GetSettings().capacity / _live.GetSettings().rate);
+        ImGui::Text("%.2f MS/s per channel, %llu dropped, drain %.2f ms/frame", _live.Throughput() / 1e6,
+            static_cast<unsigned long long>(_live.Dropped()), _live.DrainSeconds() * 1e3);
+    }
+
+    // samples written by another process, e.g. shm_producer
+    ImGui::SeparatorText("Shared memory");
+    const bool connected = _shared.IsOpen();
+    ImGui::BeginDisabled(connected);
+    ImGui::InputText("Segment", _sharedName, sizeof(_sharedName));
+    ImGui::EndDisabled();
+    if (ImGui::Button(connected ? "Disconnect" : "Connect"))
+    {
+        if (connected)
+            _shared.Close();
+        else
+            _sharedFailed = !_shared.Open(_sharedName, _liveSettings.capacity);
+    }
+    if (_shared.IsOpen())
+    {
+        ImGui::SameLine();
+        if (ImGui::Button("Plot##shared"))
+            plotChannels(_shared, _shared.Capacity() / _shared.Rate());
+        ImGui::Text("%zu channels, %.2f MS/s per channel, %llu dropped, drain %.2f ms/frame", _shared.Channels() - 1,
+            _shared.Throughput() / 1e6, static_cast<unsigned long long>(_shared.Dropped()), _shared.DrainSeconds() * 1e3);
+        ImGui::Text("latency write to frame %.2f ms average, %.2f ms max", _shared.LatencyAverage() * 1e3, _shared.LatencyMax() * 1e3);
+    }
+    else if (_sharedFailed)
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("no producer on this segment");
+    }
+    ImGui::End();
+}
+
 void PlotApp::AddColToPlot(int idx, Plot& plot) 
 { 
-    std::vector<double> ys;
-    for (int row = 1; row < _files[_currentFileIndex].content.size(); row++)
-        ys.push_back(atof(_files[_currentFileIndex].content[row][idx].c_str()));
+    AddColsToPlot(_files[_currentFileIndex], { idx }, plot);
+}
 
-    plot.AddCol(_files[_currentFileIndex].content[0][idx], ys);
+void PlotApp::AddColsToPlot(File& file, const std::vector<int>& cols, Plot& plot)
+{
+    // the dataset of a loading file belongs to its job, e.g. when a column is dropped after the file started parsing
+    if (file.loading)
+        return;
+    // the columns not parsed yet are parsed in one job and join the plot when it is done
+    std::vector<size_t> pending;
+    for (int col : cols)
+    {
+        if (AddParsedCol(file, col, plot))
+            continue;
+        file.waiting.push_back({ _plots.HandleOf(plot), col });
+        pending.push_back(col);
+    }
+    if (!pending.empty() && file.x_column >= 0)
+        pending.push_back(file.x_column);
+    ParseLazyColumns(file, std::move(pending));
+}
+
+bool PlotApp::AddParsedCol(File& file, int idx, Plot& plot)
+{
+    Dataset& data = file.data;
+    const int x = file.x_column >= 0 && file.x_column != idx ? file.x_column : -1;
+    if (!data.Materialized(idx) || (x >= 0 && !data.Materialized(x)))
+        return false;
+    plot.AddCol(data.Name(idx), data.Column(idx), x >= 0 ? data.Column(x) : nullptr);
+    return true;
 }
 
 void PlotApp::CreateLists()
@@ -313,38 +502,167 @@ void PlotApp::CreateLists()
 
     if (ImGui::BeginListBox("##FileNames", ImVec2(width / 3, ImGui::GetContentRegionAvail().y)))
     {
+        size_t removed = _files.size();
         for (size_t fileIdx = 0; fileIdx < _files.size(); fileIdx++)
         {
             bool selected = _currentFileIndex == fileIdx;
-            ImGui::Selectable(_files[fileIdx].name.c_str(), &selected);
+            const std::shared_ptr<LoadJob>& job = _files[fileIdx].loading;
+            ImGui::PushID(static_cast<int>(fileIdx));
+            // a loading file can be selected to look at its fields once its header is read
+            ImGui::Selectable(_files[fileIdx].name.c_str(), &selected, job && !job->progress.headerReady ? ImGuiSelectableFlags_Disabled : 0);
+            if (job)
+            {
+                char overlay[64];
+                snprintf(overlay, sizeof(overlay), "%.0f%%  %.1f MB/s", job->Fraction() * 100.0f, job->BytesPerSecond() / 1e6);
+                ImGui::ProgressBar(job->Fraction(), ImVec2(-ImGui::CalcTextSize("Cancel").x - 3 * ImGui::GetStyle().ItemSpacing.x, 0), overlay);
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Cancel"))
+                    job->progress.cancel = true;
+            }
+            else
+            {
+                if (ImGui::IsItemHovered())
+                {
+                    const Dataset& data = _files[fileIdx].data;
+                    if (!_files[fileIdx].error.empty())
+                        ImGui::SetTooltip("%s", _files[fileIdx].error.c_str());
+                    else if (data.Paged())
+                        ImGui::SetTooltip("%zu rows x %zu columns (paged from disk)\nresident pages: %.1f MB of %.1f MB\nmin/max pyramid: %.1f MB\npage reads failed: %llu",
+                            data.Rows(), data.Columns(), data.ResidentBytes() / 1e6, data.PagedBytes() / 1e6, data.PyramidBytes() / 1e6,
+                            static_cast<unsigned long long>(PageCache::Instance().Failures()));
+                    else
+                        ImGui::SetTooltip("%zu rows x %zu columns (%zu %s)\nsamples: %.1f MB (%.1f MB as double)\nmin/max pyramid: %.1f MB",
+                            data.Rows(), data.Columns(), data.MaterializedColumns(), data.FromCache() ? "mapped from cache" : "parsed",
+                            data.DataBytes() / 1e6, data.Rows() * data.MaterializedColumns() * sizeof(double) / 1e6, data.PyramidBytes() / 1e6);
+                }
+                // a followed file keeps appending the rows written to it
+                if (ImGui::BeginPopupContextItem())
+                {
+                    ImGui::MenuItem("Follow", nullptr, &_files[fileIdx].follow, !_files[fileIdx].data.Paged());
+                    if (ImGui::MenuItem("Remove"))
+                        removed = fileIdx;
+                    ImGui::EndPopup();
+                }
+                if (!_files[fileIdx].error.empty())
+                {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(failed)");
+                }
+                if (_files[fileIdx].data.Paged())
+                {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(paged %.0f / %.0f MB)", _files[fileIdx].data.ResidentBytes() / 1e6, _files[fileIdx].data.PagedBytes() / 1e6);
+                }
+                if (_files[fileIdx].follow)
+                {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(following)");
+                }
+            }
             if (selected && _currentFileIndex != fileIdx)
             {
                 _currentFileIndex = fileIdx;
                 _selectedFields.clear();
                 _lastSelectedField = -1;
             }
+            ImGui::PopID();
         }
+        if (removed < _files.size())
+            RemoveFile(removed);
         ImGui::EndListBox();
     }
     ImGui::SameLine();
     if (ImGui::BeginListBox("##Fields", ImVec2(2 * width / 3, ImGui::GetContentRegionAvail().y)))
     {
-        if (_currentFileIndex >= 0 && _currentFileIndex < _files.size())
+        if (_currentFileIndex < _files.size() && _files[_currentFileIndex].loading)
+        {
+            // only the header of a loading file may be read, its columns are still being parsed
+            const LoadJob& job = *_files[_currentFileIndex].loading;
+            if (job.progress.headerReady)
+            {
+                for (size_t col = 0; col < job.data.Columns(); col++)
+                {
+                    ImGui::Selectable(job.data.Name(col).c_str(), _selectedFields.count(static_cast<int>(col)) > 0, ImGuiSelectableFlags_Disabled);
+                    if (std::find(job.columns.begin(), job.columns.end(), col) != job.columns.end())
+                    {
+                        ImGui::SameLine();
+                        ImGui::TextDisabled("(parsing)");
+                    }
+                }
+            }
+        }
+        else if (_currentFileIndex >= 0 && _currentFileIndex < _files.size())
         {
-            for (int row = 0; row < _files[_currentFileIndex].content[0].size(); row++)
+            bool selectionChanged = false;
+            bool xChanged = false;
+            for (int row = 0; row < _files[_currentFileIndex].data.Columns(); row++)
             {
                 bool beforeSelectedField = _selectedFields.find(row) != _selectedFields.end();
                 bool selectedField = beforeSelectedField;
-                ImGui::Selectable(_files[_currentFileIndex].content[0][row].c_str(), &selectedField);
+                File& file = _files[_currentFileIndex];
+                ImGui::Selectable(file.data.Name(row).c_str(), &selectedField);
+                if (ImGui::BeginPopupContextItem())
+                {
+                    if (ImGui::MenuItem("Use as X", nullptr, file.x_column == row))
+                    {
+                        file.x_column = file.x_column == row ? -1 : row;
+                        xChanged = true;
+                    }
+                    // the narrow types save memory; integers round samples that do not fit them exactly
+                    if (file.data.Materialized(row) && !file.data.Paged() && ImGui::BeginMenu("Storage"))
+                    {
+                        const ColumnBufferPtr column = file.data.Column(row);
+                        const StorageType current = column->Format().type;
+                        if (ImGui::MenuItem("Narrowest exact"))
+                            file.data.StoreExact(row);
+                        ImGui::Separator();
+                        for (StorageType type : { StorageType::Double, StorageType::Float, StorageType::Int32, StorageType::Int16, StorageType::Compressed })
+                        {
+                            const bool integer = type == StorageType::Int32 || type == StorageType::Int16;
+                            if (ImGui::MenuItem(StorageName(type), nullptr, current == type, !(integer && column->HasGaps())))
+                                file.data.StoreAs(row, type);
+                        }
+                        ImGui::EndMenu();
+                    }
+                    ImGui::EndPopup();
+                }
+                if (file.x_column == row)
+                {
+                    ImGui::SameLine();
+                    ImGui::TextDisabled(!file.data.Materialized(row) || file.data.Column(row)->Monotonic() ? "(X)" : "(X, unsorted)");
+                }
+                if (file.data.Materialized(row) && file.data.Column(row)->Format().type == StorageType::Compressed)
+                {
+                    const ColumnBufferPtr column = file.data.Column(row);
+                    ImGui::SameLine();
+                    const double bytes = static_cast<double>(column->Bytes() + column->Pyramid().Bytes());
+                    ImGui::TextDisabled("(compressed %.1f:1 with its pyramid)", column->Size() * sizeof(double) / bytes);
+                }
+                if (file.data.Materialized(row) && file.data.Issues(row).Any())
+                {
+                    const ParseIssues& issues = file.data.Issues(row);
+                    ImGui::SameLine();
+                    ImGui::TextDisabled("(%llu without value)", static_cast<unsigned long long>(issues.empty + issues.invalid));
+                    if (ImGui::IsItemHovered())
+                    {
+                        if (issues.invalid > 0)
+                            ImGui::SetTooltip("%llu empty cells\n%llu cells that are not numbers, the first in data row %llu",
+                                static_cast<unsigned long long>(issues.empty), static_cast<unsigned long long>(issues.invalid),
+                                static_cast<unsigned long long>(issues.firstInvalid + 1));
+                        else
+                            ImGui::SetTooltip("%llu empty cells", static_cast<unsigned long long>(issues.empty));
+                    }
+                }
                 if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_None)) {
                     ImGui::SetDragDropPayload("ColDragAndDrop", &row, sizeof(int));
                     //ImPlot::ItemIcon(dnd[k].Color); ImGui::SameLine();
-                    ImGui::TextUnformatted(_files[_currentFileIndex].content[0][row].c_str());
+                    ImGui::TextUnformatted(_files[_currentFileIndex].data.Name(row).c_str());
                     ImGui::EndDragDropSource();
                 }
 
                 if (beforeSelectedField != selectedField)
                 {
+                    selectionChanged = true;
                     if (!ImGui::IsKeyDown(ImGuiKey_ModCtrl))
                     {
                         _selectedFields.clear();
@@ -368,6 +686,16 @@ void PlotApp::CreateLists()
 
                 }
             }
+
+            // columns of a lazily loaded file are parsed in the background when they are selected, all in one pass
+            if (selectionChanged || xChanged)
+            {
+                File& file = _files[_currentFileIndex];
+                std::vector<size_t> cols(_selectedFields.begin(), _selectedFields.end());
+                if (file.x_column >= 0)
+                    cols.push_back(file.x_column);
+                ParseLazyColumns(file, std::move(cols));
+            }
         }
         ImGui::EndListBox();
     }
@@ -440,3 +768,64 @@ bool PlotApp::CaptureFramebuffer(int x, int y, int w, int h, unsigned int* pixel
     return ImGuiApp_ImplWin32DX11_CaptureFramebuffer(viewport, x, y, w, h, pixels_rgba, user_data);
 }
 
+ImTextureID PlotApp::UpdateTexture(Texture& texture, int width, int height, const unsigned int* pixels_rgba)
+{
+    if (texture.texture && (texture.width != width || texture.height != height))
+        ReleaseTexture(texture);
+
+    if (!texture.texture)
+    {
+        D3D11_TEXTURE2D_DESC desc;
+        ZeroMemory(&desc, sizeof(desc));
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        if (_pd3dDevice->CreateTexture2D(&desc, nullptr, &texture.texture) != S_OK)
+            return nullptr;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+        ZeroMemory(&srvDesc, sizeof(srvDesc));
+        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = 1;
+        if (_pd3dDevice->CreateShaderResourceView(texture.texture, &srvDesc, &texture.view) != S_OK)
+        {
+            ReleaseTexture(texture);
+            return nullptr;
+        }
+        texture.width = width;
+        texture.height = height;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (_pd3dDeviceContext->Map(texture.texture, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped) == S_OK)
+    {
+        for (int row = 0; row < height; row++)
+            memcpy(static_cast<char*>(mapped.pData) + row * mapped.RowPitch, pixels_rgba + row * width, width * sizeof(unsigned int));
+        _pd3dDeviceContext->Unmap(texture.texture, 0);
+    }
+    return (ImTextureID)texture.view;
+}
+
+void PlotApp::ReleaseTexture(Texture& texture)
+{
+    if (texture.view) { _releasedTextures.push_back(texture.view); texture.view = nullptr; }
+    if (texture.texture) { _releasedTextures.push_back(texture.texture); texture.texture = nullptr; }
+    texture.width = texture.height = 0;
+    // once the device is gone nothing draws any more
+    if (!_pd3dDevice)
+        FreeReleasedTextures();
+}
+
+void PlotApp::FreeReleasedTextures()
+{
+    for (IUnknown* object : _releasedTextures)
+        object->Release();
+    _releasedTextures.clear();
+}
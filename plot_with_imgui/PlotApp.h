@@ -6,12 +6,31 @@
 #include <set>
 #include <map>
 #include "Plot.h"
+#include "PlotRegistry.h"
+#include "Dataset.h"
+#include "LoadQueue.h"
+#include "LiveSource.h"
+#include "SharedSource.h"
+#include "Benchmark.h"
 
 struct File
 {
 	std::string name;
-	typedef std::vector<std::vector<std::string>> FileContent;
-	FileContent content;
+	Dataset data;
+	int x_column = -1;	// column the other columns are plotted against, -1 for the sample index
+	std::shared_ptr<LoadJob> loading;	// set until the background load or parse is done, data is empty until then
+	std::vector<std::pair<PlotRegistry::Handle, int>> waiting;	// columns added to plots once they are parsed
+	std::string error;	// why the last load or parse failed, empty if it did not
+	bool follow = false;	// rows appended to the file are added to its columns
+};
+
+// RGBA texture drawn inside plots with ImPlot::PlotImage
+struct Texture
+{
+	ID3D11Texture2D* texture = nullptr;
+	ID3D11ShaderResourceView* view = nullptr;
+	int width = 0;
+	int height = 0;
 };
 
 class PlotApp
@@ -19,17 +38,33 @@ class PlotApp
 public:
 	static PlotApp& Instance() { static PlotApp instance; return instance; }
 	int MainLoop();
-	void AddPlot(const Plot& plot) { _plots.push_back(plot); }
+	PlotRegistry::Handle AddPlot(Plot&& plot) { return _plots.Add(std::move(plot)); }
 	bool CaptureFramebuffer(int x, int y, int w, int h, unsigned int* pixels_rgba, void* user_data);
+	ImTextureID UpdateTexture(Texture& texture, int width, int height, const unsigned int* pixels_rgba);
+	// the D3D objects are freed after the frame is presented, as the frame being built may still draw them
+	void ReleaseTexture(Texture& texture);
+	// the column of the current file against its X; a column not parsed yet joins the plot once it is
 	void AddColToPlot(int idx, Plot& plot);
 
 private:
 	PlotApp();
 	void ShowMainWindow();
 	void CreateLists();
+	void ShowLiveWindow();
 
 	// file manipulation
-	File LoadCSV(const std::string& filename);
+	void LoadCSV(const std::string& filename);
+	// takes the datasets of finished loads, drops the files whose load was cancelled and keeps the failed ones
+	// listed with their error
+	void UpdateLoads();
+	void RemoveFile(size_t fileIdx);
+	// parses the columns of a lazily loaded file that are not yet on _loads; the file is loading until they are
+	void ParseLazyColumns(File& file, std::vector<size_t> cols);
+	void AddColsToPlot(File& file, const std::vector<int>& cols, Plot& plot);
+	// false while the column or the X of the file is not parsed
+	bool AddParsedCol(File& file, int idx, Plot& plot);
+	// appends what was written to the followed files since the last poll
+	void FollowFiles();
 	static const char* FileNameGetter(void* user_data, int idx) { return PlotApp::Instance()._files[idx].name.c_str(); }
 
 	static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -38,6 +73,7 @@ private:
 	void CreateRenderTarget();
 	void CleanupDeviceD3D();
 	void CleanupRenderTarget();
+	void FreeReleasedTextures();
 
 	ID3D11Device*			_pd3dDevice;
 	ID3D11DeviceContext*	_pd3dDeviceContext;
@@ -46,15 +82,28 @@ private:
 	UINT					_ResizeHeight;
 	ID3D11RenderTargetView* _mainRenderTargetView;
 
-	std::vector<Plot> _plots;
+	std::vector<IUnknown*> _releasedTextures;	// declared before the plots, which release theirs when destroyed
+	PlotRegistry _plots;
 	bool _show_demo_window_implot;
 	bool _show_demo_window_imgui;
 	bool _show_main_window;
+	bool _show_benchmark_window;
+	bool _show_live_window;
+	Benchmark _benchmark;
+	LiveSource _live;
+	LiveSource::Settings _liveSettings;
+	SharedSource _shared;
+	char _sharedName[128];
+	bool _sharedFailed;	// the last attempt to open _sharedName
+	bool _outOfCore;	// load dropped files as paged datasets
+	int _pageBudgetMB;
 
 	size_t _currentFileIndex;
 	std::set<int> _selectedFields;
 	int _lastSelectedField;
 	std::vector<File> _files;
+	LoadQueue _loads;
+	std::chrono::steady_clock::time_point _lastFollow;
 
 
 };
@@ -0,0 +1,45 @@
+#include "PlotRegistry.h"
+#include <algorithm>
+
+PlotRegistry::Handle PlotRegistry::Add(Plot&& plot)
+{
+    Handle handle = _nextHandle++;
+    _added.push_back({ handle, std::make_unique<Plot>(std::move(plot)) });
+    return handle;
+}
+
+Plot* PlotRegistry::Find(Handle handle)
+{
+    auto it = std::lower_bound(_plots.begin(), _plots.end(), handle, [](const Entry& entry, Handle h) { return entry.handle < h; });
+    if (it != _plots.end() && it->handle == handle)
+        return it->plot.get();
+
+    for (auto& entry : _added)
+    {
+        if (entry.handle == handle)
+            return entry.plot.get();
+    }
+    return nullptr;
+}
+
+PlotRegistry::Handle PlotRegistry::HandleOf(const Plot& plot) const
+{
+    for (const auto* entries : { &_plots, &_added })
+    {
+        for (const auto& entry : *entries)
+        {
+            if (entry.plot.get() == &plot)
+                return entry.handle;
+        }
+    }
+    return 0;
+}
+
+void PlotRegistry::Update()
+{
+    _plots.erase(std::remove_if(_plots.begin(), _plots.end(), [](const Entry& entry) { return !*entry.plot->IsOpen(); }), _plots.end());
+
+    for (auto& entry : _added)
+        _plots.push_back(std::move(entry));
+    _added.clear();
+}
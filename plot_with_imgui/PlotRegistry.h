@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "Plot.h"
+
+// Open plot windows. Each plot lives in its own allocation and never moves, so handles and pointers
+// to it stay valid until its window is closed. Plots added while others are being drawn (e.g. the
+// Histogram button) are queued and join the list at the next Update().
+class PlotRegistry
+{
+public:
+	typedef int Handle;
+
+	Handle Add(Plot&& plot);
+	Plot* Find(Handle handle);
+	// of a plot in the registry, 0 for any other
+	Handle HandleOf(const Plot& plot) const;
+	// drops closed plots and takes in the queued ones
+	void Update();
+
+	template <typename Fn>
+	void ForEach(Fn&& fn)
+	{
+		for (auto& entry : _plots)
+			fn(*entry.plot);
+	}
+
+	size_t Size() const { return _plots.size(); }
+
+private:
+	struct Entry
+	{
+		Handle handle;
+		std::unique_ptr<Plot> plot;
+	};
+	std::vector<Entry> _plots;	// sorted by handle
+	std::vector<Entry> _added;
+	Handle _nextHandle = 1;
+};
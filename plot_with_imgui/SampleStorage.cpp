@@ -0,0 +1,171 @@
+#include "SampleStorage.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace
+{
+    const int MaxDecimals = 6;
+    const double Powers[MaxDecimals + 1] = { 1.0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6 };
+    const double MaxExact = 9007199254740992.0; // 2^53, integers up to it are doubles
+
+    struct Analysis
+    {
+        bool floatExact = true;	// every value survives float
+        int decimals = 0;		// every value is an integer over 10^decimals; -1 if not for any up to MaxDecimals
+        double lo = std::numeric_limits<double>::infinity();	// of the finite values
+        double hi = -std::numeric_limits<double>::infinity();
+    };
+
+    bool FloatExact(double v)
+    {
+        return v != v || std::isinf(v) || (std::abs(v) <= std::numeric_limits<float>::max() && static_cast<double>(static_cast<float>(v)) == v);
+    }
+
+    bool IsDecimal(double v, int decimals)
+    {
+        const double n = std::round(v * Powers[decimals]);
+        return std::abs(n) <= MaxExact && n / Powers[decimals] == v;
+    }
+
+    // stops at the first value that fits neither float nor an integer type if early
+    Analysis Analyze(const double* values, size_t size, bool early)
+    {
+        Analysis a;
+        for (size_t i = 0; i < size; i++)
+        {
+            const double v = values[i];
+            if (std::isfinite(v))
+            {
+                a.lo = std::min(a.lo, v);
+                a.hi = std::max(a.hi, v);
+            }
+            a.floatExact = a.floatExact && FloatExact(v);
+            if (v != v)
+                a.decimals = -1; // gaps have no integer
+            // a value with fewer decimals also has more, so the count only grows
+            while (a.decimals >= 0 && !IsDecimal(v, a.decimals))
+                a.decimals = a.decimals < MaxDecimals ? a.decimals + 1 : -1;
+            if (early && !a.floatExact && a.decimals < 0)
+                break;
+        }
+        return a;
+    }
+
+    double TypeMin(StorageType type) { return type == StorageType::Int16 ? -32768.0 : -2147483648.0; }
+    double TypeMax(StorageType type) { return type == StorageType::Int16 ? 32767.0 : 2147483647.0; }
+
+    // value * 10^decimals stored as an integer minus offset, if their range fits the type
+    bool ExactInteger(const Analysis& a, StorageType type, SampleFormat& format)
+    {
+        if (a.decimals < 0 || !(a.lo <= a.hi))
+            return false;
+        const double divisor = Powers[a.decimals];
+        const double lo = std::round(a.lo * divisor);
+        const double hi = std::round(a.hi * divisor);
+        if (hi - lo > TypeMax(type) - TypeMin(type))
+            return false;
+        format.type = type;
+        format.divisor = divisor;
+        format.offset = lo - TypeMin(type);
+        return true;
+    }
+
+    template <typename T>
+    void EncodeAs(const double* values, size_t size, const SampleFormat& format, T* out)
+    {
+        const double lo = std::numeric_limits<T>::min();
+        const double hi = std::numeric_limits<T>::max();
+        for (size_t i = 0; i < size; i++)
+        {
+            const double n = std::round(values[i] * format.divisor) - format.offset;
+            out[i] = static_cast<T>(n >= lo ? (n <= hi ? n : hi) : lo); // NaN has no integer and becomes lo
+        }
+    }
+}
+
+const char* StorageName(StorageType type)
+{
+    switch (type)
+    {
+    case StorageType::Float: return "float";
+    case StorageType::Int32: return "int32";
+    case StorageType::Int16: return "int16";
+    case StorageType::Compressed: return "compressed";
+    case StorageType::Paged: return "paged";
+    default: return "double";
+    }
+}
+
+SampleFormat ChooseFormat(const double* values, size_t size)
+{
+    SampleFormat format;
+    if (size == 0)
+        return format;
+    const Analysis a = Analyze(values, size, true);
+    if (ExactInteger(a, StorageType::Int16, format) || ExactInteger(a, StorageType::Int32, format))
+        return format;
+    if (a.floatExact)
+        format.type = StorageType::Float;
+    return format;
+}
+
+double DecimalScale(const double* values, size_t size)
+{
+    const int decimals = Analyze(values, size, false).decimals;
+    return decimals >= 0 ? Powers[decimals] : 0.0;
+}
+
+SampleFormat ForceFormat(StorageType type, const double* values, size_t size)
+{
+    SampleFormat format;
+    format.type = type;
+    if (type == StorageType::Double || type == StorageType::Float || type == StorageType::Compressed)
+        return format;
+    const Analysis a = Analyze(values, size, false);
+    if (ExactInteger(a, type, format))
+        return format;
+
+    // the finite range over all but one step of the type, around 0
+    const double divisor = (TypeMax(type) - TypeMin(type) - 1) / (a.hi - a.lo);
+    format.divisor = a.lo < a.hi && std::isfinite(divisor) && divisor > 0 ? divisor : 1.0;
+    format.offset = a.lo <= a.hi ? std::round(0.5 * (a.lo + a.hi) * format.divisor) : 0.0;
+    return format;
+}
+
+bool Fits(const double* values, size_t size, const SampleFormat& format)
+{
+    if (format.type == StorageType::Double || format.type == StorageType::Compressed)
+        return true;
+    if (format.type == StorageType::Float)
+        return std::all_of(values, values + size, FloatExact);
+
+    const double lo = TypeMin(format.type);
+    const double hi = TypeMax(format.type);
+    for (size_t i = 0; i < size; i++)
+    {
+        const double n = std::round(values[i] * format.divisor) - format.offset;
+        if (!(n >= lo && n <= hi) || (n + format.offset) / format.divisor != values[i])
+            return false;
+    }
+    return true;
+}
+
+void Encode(const double* values, size_t size, const SampleFormat& format, void* out)
+{
+    switch (format.type)
+    {
+    case StorageType::Float:
+        std::transform(values, values + size, static_cast<float*>(out), [](double v) { return static_cast<float>(v); });
+        break;
+    case StorageType::Int32:
+        EncodeAs(values, size, format, static_cast<int32_t*>(out));
+        break;
+    case StorageType::Int16:
+        EncodeAs(values, size, format, static_cast<int16_t*>(out));
+        break;
+    default:
+        std::copy(values, values + size, static_cast<double*>(out));
+        break;
+    }
+}
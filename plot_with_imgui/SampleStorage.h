@@ -0,0 +1,234 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+#include <limits>
+#include "BlockCompression.h"
+#include "PageCache.h"
+
+// Types a column can keep its samples in. The narrow ones save memory: a float sample is read as is, an
+// integer one as (stored + offset) / divisor. At load a column is stored in the narrowest type that gives
+// back every sample exactly (ChooseFormat): ADC counts fit int16, values with a few decimals are integers
+// over a power of ten, and the division, being correctly rounded, returns the same double the parser did.
+// The user can also force a type (ForceFormat), which rounds the samples to the steps of that type, or
+// compress the samples (BlockCompression.h), which keeps them exact. The columns of a recording larger
+// than memory stay on disk and are read a page at a time (PageCache.h).
+enum class StorageType
+{
+	Double,
+	Float,
+	Int32,
+	Int16,
+	Compressed,
+	Paged
+};
+
+struct SampleFormat
+{
+	StorageType type = StorageType::Double;
+	double offset = 0;	// integer types only
+	double divisor = 1;
+
+	bool operator==(const SampleFormat& other) const { return type == other.type && offset == other.offset && divisor == other.divisor; }
+	bool operator!=(const SampleFormat& other) const { return !(*this == other); }
+};
+
+inline size_t StorageBytes(StorageType type)
+{
+	switch (type)
+	{
+	case StorageType::Float: return sizeof(float);
+	case StorageType::Int32: return sizeof(int32_t);
+	case StorageType::Int16: return sizeof(int16_t);
+	case StorageType::Compressed: return 0; // no size per sample, see BlockCompression::Bytes
+	case StorageType::Paged: return 0;		// nothing in memory but the pages in the cache
+	default: return sizeof(double);
+	}
+}
+
+const char* StorageName(StorageType type);
+
+// Typed view of stored samples that reads them as double. Loops over many samples are written once
+// against it and compiled for every type (see ColumnBuffer::Visit), so they read the narrow type directly.
+template <typename T>
+struct Samples
+{
+	const T* data;
+	double offset;
+	double divisor;
+
+	double operator[](size_t i) const
+	{
+		if constexpr (std::is_floating_point_v<T>)
+			return data[i];
+		else
+			return (data[i] + offset) / divisor;
+	}
+};
+
+// compressed samples; key is the Version() of their ColumnBuffer, see BlockCompression::Decoded
+struct CompressedSamples
+{
+	const void* blob;
+	uint64_t key;
+
+	double operator[](size_t i) const { return BlockCompression::At(blob, key, i); }
+};
+
+// samples on disk, read through the PageCache
+struct PagedSamples
+{
+	const PagedColumn* column;
+
+	double operator[](size_t i) const { return Paging::At(*column, i); }
+};
+
+// the sample index, for X when a column is plotted without an X column
+struct IndexSamples
+{
+	double operator[](size_t i) const { return static_cast<double>(i); }
+};
+
+// Reads stored samples of any type, deciding the type at every read; for searches that read few samples.
+struct SampleReader
+{
+	const void* data;
+	SampleFormat format;
+	uint64_t key = 0;	// compressed samples only; data is the PagedColumn of paged ones
+
+	double operator[](size_t i) const
+	{
+		switch (format.type)
+		{
+		case StorageType::Float: return static_cast<const float*>(data)[i];
+		case StorageType::Int32: return (static_cast<const int32_t*>(data)[i] + format.offset) / format.divisor;
+		case StorageType::Int16: return (static_cast<const int16_t*>(data)[i] + format.offset) / format.divisor;
+		case StorageType::Compressed: return BlockCompression::At(data, key, i);
+		case StorageType::Paged: return Paging::At(*static_cast<const PagedColumn*>(data), i);
+		default: return static_cast<const double*>(data)[i];
+		}
+	}
+};
+
+// first i in [first, last) with samples[i] >= x (LowerBoundOf) or > x (UpperBoundOf), last if none;
+// the samples with a value must never decrease. A gap (NaN) counts as the next sample with a value, or as
+// past x if none follows: the search reads on to that sample, so it costs the length of the gaps it lands in.
+template <typename S>
+size_t LowerBoundOf(const S& samples, size_t first, size_t last, double x)
+{
+	while (first < last)
+	{
+		const size_t mid = first + (last - first) / 2;
+		size_t probe = mid;
+		double value = samples[probe];
+		while (value != value && ++probe < last)
+			value = samples[probe];
+		if (probe < last && value < x)
+			first = probe + 1;
+		else
+			last = mid;
+	}
+	return first;
+}
+
+template <typename S>
+size_t UpperBoundOf(const S& samples, size_t first, size_t last, double x)
+{
+	while (first < last)
+	{
+		const size_t mid = first + (last - first) / 2;
+		size_t probe = mid;
+		double value = samples[probe];
+		while (value != value && ++probe < last)
+			value = samples[probe];
+		if (probe < last && !(x < value))
+			first = probe + 1;
+		else
+			last = mid;
+	}
+	return first;
+}
+
+// Samples that never decrease have blocks whose maxima never decrease either, so the search goes over the
+// maxima of the blocks (blockMax(b) of block b, 1 << shift samples each) first and reads only the block it
+// ends in: compressed samples decode one block, paged samples read one page. A block of nothing but gaps
+// (its max is -inf) counts as the next block, like a gap in LowerBoundOf.
+template <bool Upper, typename S, typename BlockMax>
+size_t BlockBoundOf(const S& samples, size_t first, size_t last, double x, int shift, BlockMax&& blockMax)
+{
+	if (first >= last)
+		return first;
+	const size_t blocks = ((last - 1) >> shift) + 1;
+	auto empty = [&](double hi) { return !(hi > -std::numeric_limits<double>::infinity()); };
+	size_t begin = first >> shift;
+	size_t end = blocks;
+	while (begin < end)
+	{
+		const size_t mid = begin + (end - begin) / 2;
+		size_t probe = mid;
+		double hi = blockMax(probe);
+		while (empty(hi) && ++probe < end)
+			hi = blockMax(probe);
+		if (probe < end && (Upper ? !(x < hi) : hi < x))
+			begin = probe + 1;
+		else
+			end = mid;
+	}
+	while (begin < blocks && empty(blockMax(begin)))
+		begin++;
+	const size_t from = std::max(first, begin << shift);
+	const size_t to = std::min(last, (begin + 1) << shift);
+	if (from >= to)
+		return last;
+	return Upper ? UpperBoundOf<S>(samples, from, to, x) : LowerBoundOf<S>(samples, from, to, x);
+}
+
+template <bool Upper>
+size_t CompressedBoundOf(const CompressedSamples& samples, size_t first, size_t last, double x)
+{
+	return BlockBoundOf<Upper>(samples, first, last, x, BlockCompression::BlockShift, [&](size_t block) {
+		double lo, hi;
+		BlockCompression::BlockMinMax(samples.blob, block, lo, hi);
+		return hi;
+		});
+}
+
+inline size_t LowerBoundOf(const CompressedSamples& samples, size_t first, size_t last, double x)
+{
+	return CompressedBoundOf<false>(samples, first, last, x);
+}
+
+inline size_t UpperBoundOf(const CompressedSamples& samples, size_t first, size_t last, double x)
+{
+	return CompressedBoundOf<true>(samples, first, last, x);
+}
+
+template <bool Upper>
+size_t PagedBoundOf(const PagedSamples& samples, size_t first, size_t last, double x)
+{
+	return BlockBoundOf<Upper>(samples, first, last, x, samples.column->pageShift, [&](size_t page) { return samples.column->pageMax[page]; });
+}
+
+inline size_t LowerBoundOf(const PagedSamples& samples, size_t first, size_t last, double x)
+{
+	return PagedBoundOf<false>(samples, first, last, x);
+}
+
+inline size_t UpperBoundOf(const PagedSamples& samples, size_t first, size_t last, double x)
+{
+	return PagedBoundOf<true>(samples, first, last, x);
+}
+
+// the narrowest format that gives back every value exactly; NaN (a gap) only fits float and double
+SampleFormat ChooseFormat(const double* values, size_t size);
+// the smallest power of ten up to 10^6 that turns every value into an integer a double holds exactly,
+// 0 if there is none (also for NaN and infinity)
+double DecimalScale(const double* values, size_t size);
+// a format of that type, exact if the type can hold the values exactly, otherwise spreading their range
+// over the steps of the type
+SampleFormat ForceFormat(StorageType type, const double* values, size_t size);
+// true if every value comes back exactly from format, always for Compressed; not for Paged
+bool Fits(const double* values, size_t size, const SampleFormat& format);
+// stores the values in format at out, size * StorageBytes(format.type) bytes; not for Compressed or Paged
+void Encode(const double* values, size_t size, const SampleFormat& format, void* out);
@@ -0,0 +1,196 @@
+#include "ScatterIndex.h"
+#include "Parallel.h"
+#include "PageCache.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <type_traits>
+
+size_t ScatterIndex::Nearest(const ColumnBufferPtr& data, const ColumnBufferPtr& xs, double x, double y, double sx, double sy, double& dist2)
+{
+    if (_build && _build->done.load(std::memory_order_acquire))
+    {
+        _tree = std::move(_build->tree);
+        _build.reset();
+    }
+    if (!_build && (_tree.version != data->Version() || _tree.xVersion != xs->Version()))
+    {
+        _build = std::make_shared<Build>();
+        const bool paged = data->Format().type == StorageType::Paged && xs->Format().type == StorageType::Paged;
+        std::vector<Point> points;
+        if (!paged)
+            points = Gather(*data, *xs);
+        std::thread([owner = std::weak_ptr<Build>(_build), data = paged ? data : nullptr, xs = paged ? xs : nullptr,
+            version = data->Version(), xVersion = xs->Version(), points = std::move(points)]() mutable {
+            Tree tree;
+            tree.version = version;
+            tree.xVersion = xVersion;
+            tree.points = data ? Gather(*data, *xs) : std::move(points);
+            if (owner.expired())
+                return;
+            BuildTree(tree);
+            if (std::shared_ptr<Build> build = owner.lock())
+            {
+                build->tree = std::move(tree);
+                build->done.store(true, std::memory_order_release);
+            }
+            }).detach();
+    }
+
+    // an older tree answers for the samples that were not changed since, those before limit
+    size_t best = data->Size();
+    dist2 = std::numeric_limits<double>::infinity();
+    const std::vector<Point>& points = _tree.points;
+    const size_t limit = points.empty() ? 0 : std::min(data->UnchangedUntil(_tree.version), xs->UnchangedUntil(_tree.xVersion));
+    if (limit == 0)
+        return best;
+
+    // squared scaled distance from (x, y) to the bounding box of a node
+    auto bound = [&](size_t node) {
+        const Box& box = _tree.boxes[node];
+        const double dx = (x < box.xLo ? box.xLo - x : x > box.xHi ? x - box.xHi : 0.0) * sx;
+        const double dy = (y < box.yLo ? box.yLo - y : y > box.yHi ? y - box.yHi : 0.0) * sy;
+        return dx * dx + dy * dy;
+    };
+    struct Node
+    {
+        size_t node;
+        size_t first;
+        size_t last;
+        double bound;
+    };
+    std::vector<Node> stack;
+    stack.push_back({ 0, 0, points.size(), bound(0) });
+    while (!stack.empty())
+    {
+        const Node node = stack.back();
+        stack.pop_back();
+        if (node.bound >= dist2)
+            continue;
+        if (node.last - node.first <= LeafSize)
+        {
+            for (size_t i = node.first; i < node.last; i++)
+            {
+                const Point& point = points[i];
+                const double dx = (point.x - x) * sx;
+                const double dy = (point.y - y) * sy;
+                if (point.index < limit && dx * dx + dy * dy < dist2)
+                {
+                    dist2 = dx * dx + dy * dy;
+                    best = point.index;
+                }
+            }
+            continue;
+        }
+
+        // push the farther half first so the nearer one is searched first and tightens dist2
+        const size_t mid = node.first + (node.last - node.first) / 2;
+        Node children[2] = { { 2 * node.node + 1, node.first, mid, bound(2 * node.node + 1) },
+            { 2 * node.node + 2, mid, node.last, bound(2 * node.node + 2) } };
+        if (children[0].bound < children[1].bound)
+            std::swap(children[0], children[1]);
+        for (const Node& child : children)
+        {
+            if (child.bound < dist2)
+                stack.push_back(child);
+        }
+    }
+    return best;
+}
+
+std::vector<ScatterIndex::Point> ScatterIndex::Gather(const ColumnBuffer& data, const ColumnBuffer& xs)
+{
+    static const size_t MinSamplesPerTask = 1 << 16;
+
+    const size_t size = std::min(data.Size(), xs.Size());
+    std::vector<Point> points(size);
+    // a paged column a page at a time, leaving the PageCache to the views; the others on all cores
+    auto read = [&](const ColumnBuffer& column, double Point::* field) {
+        column.Visit([&](const auto& samples) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(samples)>, PagedSamples>)
+            {
+                size_t i = 0;
+                Paging::ForEachPage(*samples.column, 0, size, [&](const double* values, size_t count) {
+                    for (size_t j = 0; j < count; j++)
+                    {
+                        points[i + j].*field = values[j];
+                        points[i + j].index = i + j;
+                    }
+                    i += count;
+                    return true;
+                    });
+            }
+            else
+            {
+                const size_t tasks = std::clamp<size_t>(size / MinSamplesPerTask, 1, WorkerCount());
+                ParallelFor(tasks, [&](size_t task) {
+                    for (size_t i = size * task / tasks; i < size * (task + 1) / tasks; i++)
+                    {
+                        points[i].*field = samples[i];
+                        points[i].index = i;
+                    }
+                    });
+            }
+            });
+    };
+    read(xs, &Point::x);
+    read(data, &Point::y);
+    return points;
+}
+
+void ScatterIndex::BuildTree(Tree& tree)
+{
+    std::vector<Point>& points = tree.points;
+    points.erase(std::remove_if(points.begin(), points.end(), [](const Point& point) { return point.x != point.x || point.y != point.y; }),
+        points.end());
+    if (points.empty())
+        return;
+    size_t nodes = 1;
+    for (size_t count = points.size(); count > LeafSize; count -= count / 2)
+        nodes = 2 * nodes + 1;
+    tree.boxes.resize(nodes);
+
+    // splits a node and goes on with its halves; the nodes of splitDepth are left to tasks, which build
+    // their subtrees in parallel
+    struct Subtree
+    {
+        size_t node;
+        size_t first;
+        size_t last;
+    };
+    std::vector<Subtree> subtrees;
+    const int splitDepth = WorkerCount() > 1 ? 3 : -1;
+    auto build = [&](auto& self, size_t node, size_t first, size_t last, int depth) -> void {
+        if (depth == splitDepth)
+        {
+            subtrees.push_back({ node, first, last });
+            return;
+        }
+        const double inf = std::numeric_limits<double>::infinity();
+        Box box = { inf, -inf, inf, -inf };
+        for (size_t i = first; i < last; i++)
+        {
+            box.xLo = std::min(box.xLo, points[i].x);
+            box.xHi = std::max(box.xHi, points[i].x);
+            box.yLo = std::min(box.yLo, points[i].y);
+            box.yHi = std::max(box.yHi, points[i].y);
+        }
+        tree.boxes[node] = box;
+        if (last - first <= LeafSize)
+            return;
+
+        // the wider side compared to the box of all samples, as X and Y have units of their own
+        const Box& all = tree.boxes[0];
+        const bool byX = (box.xHi - box.xLo) * (all.yHi - all.yLo) >= (box.yHi - box.yLo) * (all.xHi - all.xLo);
+        const size_t mid = first + (last - first) / 2;
+        std::nth_element(points.begin() + first, points.begin() + mid, points.begin() + last,
+            [byX](const Point& a, const Point& b) { return byX ? a.x < b.x : a.y < b.y; });
+        self(self, 2 * node + 1, first, mid, depth + 1);
+        self(self, 2 * node + 2, mid, last, depth + 1);
+    };
+    build(build, 0, 0, points.size(), 0);
+    ParallelFor(subtrees.size(), [&](size_t task) {
+        const Subtree& subtree = subtrees[task];
+        build(build, subtree.node, subtree.first, subtree.last, splitDepth + 1);
+        });
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "ColumnBuffer.h"
+
+// Nearest sample searches for a column plotted against an X column that is not Monotonic(), which the
+// pyramid cannot narrow down by X. The samples with both an X and a value go into a k-d tree: every node
+// splits its samples in half along the wider side of their bounding box, down to leaves of LeafSize samples.
+// The boxes are searched nearest first and skipped once farther than the best sample so far, like
+// MinMaxPyramid::Nearest, with the pixel scale applied at query time, so zooming and panning keep the tree.
+// The tree is built on a thread of its own, 24 bytes per sample, from a copy of the samples: taken on that
+// thread for paged columns, which never change, and on the calling thread (on all cores) otherwise, as the
+// owner may change the columns after the frame. Until the tree of the current samples is done, the previous
+// one answers for the samples that were not changed since (a followed file keeps growing), or none does.
+class ScatterIndex
+{
+public:
+	// index of the sample nearest to (x, y) when sample i is drawn at (xs[i], data[i]), distances measured
+	// after scaling x by sx and y by sy; data.Size() if there is none or no tree yet. Starts the tree of the
+	// current samples when the one answering is older.
+	size_t Nearest(const ColumnBufferPtr& data, const ColumnBufferPtr& xs, double x, double y, double sx, double sy, double& dist2);
+	// true while the tree of the current samples is being built
+	bool Building() const { return _build != nullptr; }
+
+private:
+	static const size_t LeafSize = 32;
+
+	struct Point
+	{
+		double x;
+		double y;
+		size_t index;
+	};
+	struct Box
+	{
+		double xLo, xHi;
+		double yLo, yHi;
+	};
+	struct Tree
+	{
+		uint64_t version = 0;	// of the data and X it was built from
+		uint64_t xVersion = 0;
+		std::vector<Point> points;	// in tree order: a node holds points[first, last), its children the halves
+		std::vector<Box> boxes;		// of the nodes, the children of node n are 2n + 1 and 2n + 2
+	};
+	// the tree being built; the thread holds it weakly and drops its work once it is gone
+	struct Build
+	{
+		std::atomic<bool> done{ false };
+		Tree tree;	// written by the thread before done
+	};
+
+	// the samples in index order, those without an X or a value included
+	static std::vector<Point> Gather(const ColumnBuffer& data, const ColumnBuffer& xs);
+	// drops the points without an X or a value and orders the rest into the tree
+	static void BuildTree(Tree& tree);
+
+	Tree _tree;
+	std::shared_ptr<Build> _build;
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+
+// Layout of the shared memory segment an acquisition process writes samples into and the viewer maps
+// (a named file mapping, see SharedSource). The producer and the viewer both include this header.
+//
+// The segment is a Header, one Channel per channel, then one ring of capacity doubles per channel at
+// dataOffset. Channel 0 holds the time of the samples (seconds since the epoch), the others the signals.
+// The producer never waits for the viewer: it keeps overwriting the oldest samples, and a reader that
+// falls behind or is overtaken while copying finds out from the sequence counters and skips what was lost.
+//
+// Writing n samples to a channel whose end is w:
+//   begin = w + n (relaxed), release fence, write the samples into slots w .. w+n-1 (modulo capacity),
+//   end = w + n (release).
+// Reading the samples [from, to), to <= end (acquire):
+//   copy the slots, acquire fence, load begin; samples below begin - capacity may have been
+//   overwritten during the copy and are dropped.
+// After every batch the producer stamps the time it finished writing into stampEnd/stampTime, guarded by
+// stampSequence (odd while the stamp is written), from which the viewer measures the latency to the frame.
+namespace SharedSegment
+{
+	const char Magic[8] = { 'P', 'W', 'I', 'S', 'H', 'M', 'E', 'M' };
+	const uint32_t Version = 1;
+	const char* const DefaultName = "Local\\plot_with_imgui";
+
+	struct Header
+	{
+		char magic[8];
+		std::atomic<uint32_t> version;	// stored last by the producer, 0 while it sets up and after it quit
+		uint32_t channels;				// with the time
+		uint64_t capacity;				// samples per channel ring, a power of two
+		double rate;					// samples per second and channel the producer aims for
+		std::atomic<uint64_t> session;	// differs every time a producer sets the segment up
+		uint64_t dataOffset;			// of the first ring
+		uint64_t bytes;					// of the whole segment
+
+		alignas(64) std::atomic<uint64_t> stampSequence;
+		std::atomic<uint64_t> stampEnd;		// samples written to every channel at the stamp
+		std::atomic<int64_t> stampTime;		// Now() when they were
+	};
+
+	struct Channel
+	{
+		char name[48];
+		uint32_t type;			// ColumnType
+		uint32_t reserved;
+		alignas(64) std::atomic<uint64_t> begin;	// end of the samples being written
+		std::atomic<uint64_t> end;					// end of the samples written
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "the counters are shared between processes");
+
+	inline uint64_t SegmentBytes(uint32_t channels, uint64_t capacity)
+	{
+		return (sizeof(Header) + channels * sizeof(Channel) + 63) / 64 * 64 + channels * capacity * sizeof(double);
+	}
+
+	inline Channel* Channels(Header* header) { return reinterpret_cast<Channel*>(header + 1); }
+	inline const Channel* Channels(const Header* header) { return reinterpret_cast<const Channel*>(header + 1); }
+	inline double* Ring(Header* header, size_t channel)
+	{
+		return reinterpret_cast<double*>(reinterpret_cast<char*>(header) + header->dataOffset) + channel * header->capacity;
+	}
+	inline const double* Ring(const Header* header, size_t channel)
+	{
+		return reinterpret_cast<const double*>(reinterpret_cast<const char*>(header) + header->dataOffset) + channel * header->capacity;
+	}
+
+	// nanoseconds of the steady clock, which on Windows is QueryPerformanceCounter and so the same in every process
+	inline int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
@@ -0,0 +1,202 @@
+#include "SharedSource.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace SharedSegment;
+
+namespace
+{
+    // the segment a producer finished setting up, with a layout that fits in bytes
+    bool Valid(const Header* header)
+    {
+        const uint64_t capacity = header->capacity;
+        return memcmp(header->magic, Magic, sizeof(Magic)) == 0 && header->version.load(std::memory_order_acquire) == Version &&
+            header->channels > 0 && capacity > 0 && (capacity & (capacity - 1)) == 0 &&
+            header->bytes == SegmentBytes(header->channels, capacity) &&
+            header->dataOffset == header->bytes - header->channels * capacity * sizeof(double);
+    }
+}
+
+bool SharedSource::Open(const std::string& name, size_t capacity)
+{
+    Close();
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (!mapping)
+        return false;
+
+    // the header tells how much to map
+    const Header* header = static_cast<const Header*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(Header)));
+    const uint64_t bytes = header && Valid(header) ? header->bytes : 0;
+    if (header)
+        UnmapViewOfFile(header);
+    if (bytes > 0)
+        header = static_cast<const Header*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, static_cast<size_t>(bytes)));
+    if (bytes == 0 || !header || !Valid(header) || header->bytes != bytes)
+    {
+        if (bytes > 0 && header)
+            UnmapViewOfFile(header);
+        CloseHandle(mapping);
+        return false;
+    }
+
+    _mapping = mapping;
+    _header = header;
+    _name = name;
+    _session = header->session.load(std::memory_order_acquire);
+    _ring = header->capacity;
+    _dataOffset = header->dataOffset;
+    _bytes = bytes;
+    _capacity = std::max<size_t>(1, capacity);
+    const Channel* channels = SharedSegment::Channels(header);
+    for (uint32_t channel = 0; channel < header->channels; channel++)
+    {
+        const ColumnType type = channels[channel].type == static_cast<uint32_t>(ColumnType::Time) ? ColumnType::Time : ColumnType::Number;
+        _columns.push_back(std::make_shared<ColumnBuffer>(std::vector<double>(), type));
+        _names.emplace_back(channels[channel].name, strnlen(channels[channel].name, sizeof(channels[channel].name)));
+    }
+
+    // start with what the rings still hold
+    uint64_t end = UINT64_MAX;
+    for (size_t channel = 0; channel < _columns.size(); channel++)
+        end = std::min(end, channels[channel].end.load(std::memory_order_acquire));
+    _read = end > _ring ? end - _ring : 0;
+
+    _stampTime = 0;
+    _stampEnd = 0;
+    _dropped = 0;
+    _throughput = 0;
+    _latencyAverage = _latencyMax = 0;
+    _windowSamples = _windowFrames = 0;
+    _windowLatency = _windowLatencyMax = 0;
+    _windowStart = std::chrono::steady_clock::now();
+    return true;
+}
+
+void SharedSource::Close()
+{
+    // the columns stay with the plots that show them
+    if (_header)
+        UnmapViewOfFile(_header);
+    if (_mapping)
+        CloseHandle(_mapping);
+    _header = nullptr;
+    _mapping = nullptr;
+    _columns.clear();
+    _names.clear();
+    _scratch = std::vector<double>();
+}
+
+const double* SharedSource::Ring(size_t channel) const
+{
+    return reinterpret_cast<const double*>(reinterpret_cast<const char*>(_header) + _dataOffset) + channel * _ring;
+}
+
+size_t SharedSource::Drain()
+{
+    if (!_header)
+        return 0;
+    const auto start = std::chrono::steady_clock::now();
+    if (_header->version.load(std::memory_order_acquire) != Version)
+    {
+        Close();
+        return 0;
+    }
+    if (_header->session.load(std::memory_order_acquire) != _session || _header->channels != _columns.size() ||
+        _header->capacity != _ring || _header->dataOffset != _dataOffset || _header->bytes != _bytes)
+    {
+        // a new producer, maybe with another layout: map the segment again, the plots keep the old columns
+        const std::string name = _name;
+        if (!Open(name, _capacity))
+            return 0;
+    }
+
+    // the stamp first: the rings are at least as far as the stamp says
+    const uint64_t sequence = _header->stampSequence.load(std::memory_order_acquire);
+    const uint64_t stampEnd = _header->stampEnd.load(std::memory_order_relaxed);
+    const int64_t stampTime = _header->stampTime.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const bool stamped = (sequence & 1) == 0 && _header->stampSequence.load(std::memory_order_relaxed) == sequence;
+
+    const Channel* channels = SharedSegment::Channels(_header);
+    const size_t channelCount = _columns.size();
+    uint64_t to = UINT64_MAX;
+    for (size_t channel = 0; channel < channelCount; channel++)
+        to = std::min(to, channels[channel].end.load(std::memory_order_acquire));
+    size_t count = 0;
+    if (to > _read)
+    {
+        // copy out first, then check what the producer overwrote in the meantime; the samples before
+        // the newest _capacity ones would leave the columns right away and are not copied
+        const uint64_t ring = _ring;
+        const uint64_t oldest = std::max(_read, to > ring ? to - ring : 0);
+        const uint64_t from = std::max<uint64_t>(oldest, to > _capacity ? to - _capacity : 0);
+        const size_t copied = static_cast<size_t>(to - from);
+        const size_t at = static_cast<size_t>(from & (ring - 1));
+        const size_t first = std::min<size_t>(copied, static_cast<size_t>(ring) - at);
+        _scratch.resize(copied * channelCount);
+        for (size_t channel = 0; channel < channelCount; channel++)
+        {
+            const double* samples = Ring(channel);
+            double* out = _scratch.data() + channel * copied;
+            memcpy(out, samples + at, first * sizeof(double));
+            memcpy(out + first, samples, (copied - first) * sizeof(double));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t valid = from;
+        for (size_t channel = 0; channel < channelCount; channel++)
+        {
+            const uint64_t begin = channels[channel].begin.load(std::memory_order_relaxed);
+            if (begin > ring)
+                valid = std::max(valid, begin - ring);
+        }
+        valid = std::min(valid, to);
+
+        // staggered like the live source, so the channels do not all move their windows in the same frame
+        const size_t skip = static_cast<size_t>(valid - from);
+        count = static_cast<size_t>(to - valid);
+        for (size_t channel = 0; channel < channelCount && count > 0; channel++)
+        {
+            const size_t slack = _capacity / 2 + _capacity / 2 * channel / channelCount;
+            _columns[channel]->Scroll(_scratch.data() + channel * copied + skip, count, _capacity, slack);
+        }
+        _dropped += (oldest - _read) + (valid - from);
+        _read = to;
+    }
+    if (stamped && stampEnd <= _read && stampEnd > _stampEnd)
+    {
+        _stampEnd = stampEnd;
+        _stampTime = stampTime;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    _drainSeconds = std::chrono::duration<double>(now - start).count();
+    _windowSamples += count;
+    return count;
+}
+
+void SharedSource::FrameShown()
+{
+    if (!_header)
+        return;
+    if (_stampTime != 0)
+    {
+        const double latency = (Now() - _stampTime) * 1e-9;
+        _windowLatency += latency;
+        _windowLatencyMax = std::max(_windowLatencyMax, latency);
+        _windowFrames++;
+        _stampTime = 0;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const double window = std::chrono::duration<double>(now - _windowStart).count();
+    if (window >= 1.0)
+    {
+        _throughput = _windowSamples / window;
+        _latencyAverage = _windowFrames > 0 ? _windowLatency / _windowFrames : 0;
+        _latencyMax = _windowLatencyMax;
+        _windowSamples = _windowFrames = 0;
+        _windowLatency = _windowLatencyMax = 0;
+        _windowStart = now;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include "SharedSegment.h"
+#include "ColumnBuffer.h"
+
+// Channels written by another process into a shared memory segment (see SharedSegment.h). The viewer maps
+// the segment read-only and, once per frame, copies what was written since the last frame into scrolling
+// column buffers, like LiveSource does with its rings. Nothing goes through files or sockets.
+// The plots do not read the rings in place: the producer overwrites them at any time and a copy is only
+// known to be intact after it was made, so the new samples go to a scratch buffer first and only those
+// still intact then go on into the columns. That is two copies of what arrived since the last frame.
+// The latency reported is the time from the producer finishing a batch to the frame that shows it.
+class SharedSource
+{
+public:
+	SharedSource() = default;
+	~SharedSource() { Close(); }
+	SharedSource(const SharedSource&) = delete;
+	SharedSource& operator=(const SharedSource&) = delete;
+
+	// maps the segment of that name; false if there is none or no producer has set it up.
+	// The columns keep the newest capacity samples.
+	bool Open(const std::string& name, size_t capacity);
+	void Close();
+	bool IsOpen() const { return _header != nullptr; }
+
+	// UI thread, before the frame: copies the new samples into the columns, the same number into every
+	// channel; returns how many per channel. Closes the source when the producer quit, and opens the segment
+	// again when a producer set it up anew.
+	size_t Drain();
+	// UI thread, after the frame was presented
+	void FrameShown();
+
+	size_t Channels() const { return _columns.size(); }	// with the time
+	const std::string& Name(size_t channel) const { return _names[channel]; }
+	ColumnBufferPtr Column(size_t channel) const { return _columns[channel]; }
+	size_t Capacity() const { return _capacity; }
+	double Rate() const { return _header ? _header->rate : 0; }
+
+	double Throughput() const { return _throughput; }	// samples per second and channel, over the last second
+	uint64_t Dropped() const { return _dropped; }		// samples per channel overwritten before they were read
+	double DrainSeconds() const { return _drainSeconds; }
+	// from the producer's stamp to Present, over the last second
+	double LatencyAverage() const { return _latencyAverage; }
+	double LatencyMax() const { return _latencyMax; }
+
+private:
+	// the rings are found with the layout Open() checked against the mapped size, never with the header's
+	// current fields, which a restarting producer may change at any time
+	const double* Ring(size_t channel) const;
+
+	void* _mapping = nullptr;
+	const SharedSegment::Header* _header = nullptr;
+	std::string _name;
+	uint64_t _session = 0;
+	uint64_t _ring = 0;			// samples per channel ring
+	uint64_t _dataOffset = 0;
+	uint64_t _bytes = 0;		// mapped
+	size_t _capacity = 0;
+	uint64_t _read = 0;		// samples per channel read so far
+	std::vector<std::shared_ptr<ColumnBuffer>> _columns;
+	std::vector<std::string> _names;
+	std::vector<double> _scratch;
+
+	int64_t _stampTime = 0;		// of the newest batch in the columns, not yet shown
+	uint64_t _stampEnd = 0;
+
+	std::chrono::steady_clock::time_point _windowStart;
+	size_t _windowSamples = 0;
+	size_t _windowFrames = 0;
+	double _windowLatency = 0;
+	double _windowLatencyMax = 0;
+	double _throughput = 0;
+	uint64_t _dropped = 0;
+	double _drainSeconds = 0;
+	double _latencyAverage = 0;
+	double _latencyMax = 0;
+};
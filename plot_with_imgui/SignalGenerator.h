@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+// Test signals of the live inputs, shared by LiveSource and the shared memory producer (shm_producer).
+// Channel 0 holds the time of the samples (seconds since the epoch), every other channel a sine of its own
+// frequency plus a little noise. The sines advance by rotating (cos, sin) pairs, a few multiplications per sample.
+class SignalGenerator
+{
+public:
+	// channels with the time; epoch is the time of the first sample
+	SignalGenerator(size_t channels, double rate, double epoch)
+		: _rate(rate), _epoch(epoch), _re(channels, 1.0), _im(channels, 0.0), _stepRe(channels), _stepIm(channels)
+	{
+		const double Pi = 3.14159265358979323846;
+		for (size_t channel = 1; channel < channels; channel++)
+		{
+			const double frequency = 0.5 + 0.37 * channel;
+			_stepRe[channel] = std::cos(2 * Pi * frequency / rate);
+			_stepIm[channel] = std::sin(2 * Pi * frequency / rate);
+		}
+	}
+
+	size_t Channels() const { return _re.size(); }
+	uint64_t Produced() const { return _produced; }
+
+	// the next count samples of every channel into batch[channel][0, count)
+	void Next(std::vector<std::vector<double>>& batch, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			batch[0][i] = _epoch + (_produced + i) / _rate;
+		for (size_t channel = 1; channel < _re.size(); channel++)
+		{
+			double* values = batch[channel].data();
+			double r = _re[channel], m = _im[channel];
+			const double sr = _stepRe[channel], si = _stepIm[channel];
+			const double offset = 3.0 * channel;
+			for (size_t i = 0; i < count; i++)
+			{
+				_noise ^= _noise << 13;
+				_noise ^= _noise >> 7;
+				_noise ^= _noise << 17;
+				values[i] = offset + m + 0.1 * (static_cast<double>(_noise >> 11) * 0x1.0p-53 - 0.5);
+				const double next = r * sr - m * si;
+				m = r * si + m * sr;
+				r = next;
+			}
+			const double norm = 1.0 / std::sqrt(r * r + m * m); // keep the rotation from drifting
+			_re[channel] = r * norm;
+			_im[channel] = m * norm;
+		}
+		_produced += count;
+	}
+
+private:
+	double _rate;
+	double _epoch;
+	uint64_t _produced = 0;
+	uint64_t _noise = 0x9E3779B97F4A7C15ull;
+	std::vector<double> _re, _im, _stepRe, _stepIm;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+// Ring buffer between one producer thread and one consumer thread, without locks: the producer only
+// writes _tail and the consumer only writes _head, each publishing its side with a release store that
+// the other side reads with an acquire load. The two indices sit on their own cache lines so the
+// threads do not invalidate each other's line on every update. T must be trivially copyable.
+template <typename T>
+class SpscRing
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit SpscRing(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		_items.resize(size);
+		_mask = size - 1;
+	}
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// producer: slots free for Push
+	size_t Free() const
+	{
+		return _items.size() - (_tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_acquire));
+	}
+
+	// producer: copies in as many of the values as fit, returns how many
+	size_t Push(const T* values, size_t count)
+	{
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		count = std::min(count, _items.size() - (tail - _head.load(std::memory_order_acquire)));
+		const size_t at = tail & _mask;
+		const size_t first = std::min(count, _items.size() - at);
+		memcpy(_items.data() + at, values, first * sizeof(T));
+		memcpy(_items.data(), values + first, (count - first) * sizeof(T));
+		_tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	// consumer: values ready to be consumed
+	size_t Available() const
+	{
+		return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_relaxed);
+	}
+
+	// consumer: hands at most count values to fn(const T* values, size_t count), in at most two
+	// contiguous pieces and without copying, then frees their slots; returns how many
+	template <typename Fn>
+	size_t Consume(size_t count, Fn&& fn)
+	{
+		const size_t head = _head.load(std::memory_order_relaxed);
+		count = std::min(count, _tail.load(std::memory_order_acquire) - head);
+		const size_t at = head & _mask;
+		const size_t first = std::min(count, _items.size() - at);
+		if (first > 0)
+			fn(_items.data() + at, first);
+		if (count > first)
+			fn(_items.data(), count - first);
+		_head.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+private:
+	std::vector<T> _items;
+	size_t _mask;
+	alignas(64) std::atomic<size_t> _head{ 0 };	// next value to consume
+	alignas(64) std::atomic<size_t> _tail{ 0 };	// next slot to fill
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// The blocks of samples a thread read last (decoded compression blocks, pages of a paged column), held
+// in a few slots of its own, so a reader going through a few places at a time (X and Y, the edges of a
+// range) loads every block once and takes no lock per sample. Blocks are told apart by the key of their
+// column and their index; the block returned last is checked inline before the slots are searched.
+// Slot is what holds a block's values, and every Slot type has a cache of its own.
+template <typename Slot, int Ways = 8>
+class ThreadBlockCache
+{
+public:
+	// the values of block if it is the one returned last on this thread, null otherwise
+	static const double* Last(uint64_t key, size_t block)
+	{
+		const Recent& last = t_last;
+		return last.values && last.key == key && last.block == block ? last.values : nullptr;
+	}
+
+	// the values of block; when no slot holds it, the oldest slot is given to load(slot), which fills it
+	// and returns the values
+	template <typename Load>
+	static const double* Get(uint64_t key, size_t block, Load&& load)
+	{
+		Slots& slots = t_slots;
+		int way = 0;
+		while (way < Ways && !(slots.values[way] && slots.keys[way] == key && slots.blocks[way] == block))
+			way++;
+		if (way == Ways)
+		{
+			// a reader of two places keeps both of its current blocks
+			way = slots.next;
+			slots.next = (slots.next + 1) % Ways;
+			slots.values[way] = load(slots.held[way]);
+			slots.keys[way] = key;
+			slots.blocks[way] = block;
+		}
+		t_last = { key, block, slots.values[way] };
+		return slots.values[way];
+	}
+
+private:
+	struct Recent
+	{
+		uint64_t key = 0;
+		size_t block = 0;
+		const double* values = nullptr;
+	};
+	struct Slots
+	{
+		uint64_t keys[Ways] = {};
+		size_t blocks[Ways] = {};
+		const double* values[Ways] = {};
+		Slot held[Ways];
+		int next = 0;
+	};
+
+	static inline thread_local Recent t_last;
+	static inline thread_local Slots t_slots;
+};
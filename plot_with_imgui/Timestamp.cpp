@@ -0,0 +1,253 @@
+#include "Timestamp.h"
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    const int64_t NsPerSecond = 1000000000;
+
+    // days since 1970-01-01 of a proleptic Gregorian date
+    int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d)
+    {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    void CivilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d)
+    {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(z - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+    }
+
+    uint64_t Load8(const char* p)
+    {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    // Byte i of v is character i of the text (little endian). True if every byte selected by mask is
+    // '0'..'9': the high nibble must be 3, and adding 6 must not carry out of the low nibble.
+    bool AllDigits(uint64_t v, uint64_t mask)
+    {
+        const uint64_t high = 0xF0F0F0F0F0F0F0F0ull & mask;
+        const uint64_t three = 0x3030303030303030ull & mask;
+        const uint64_t six = 0x0606060606060606ull & mask;
+        return (v & high) == three && (((v & mask) + six) & high) == three;
+    }
+
+    // two digits starting at byte i of v, which has been checked with AllDigits
+    unsigned Two(uint64_t v, int i)
+    {
+        return static_cast<unsigned>(((v >> (8 * i)) & 0x0F) * 10 + ((v >> (8 * i + 8)) & 0x0F));
+    }
+
+    // ".ffffff" after the seconds; returns the position after it, or nullptr if there are no digits
+    const char* ParseFraction(const char* p, const char* end, int64_t& ns)
+    {
+        ns = 0;
+        if (p == end || (*p != '.' && *p != ','))
+            return p;
+        p++;
+        int64_t scale = NsPerSecond;
+        const char* first = p;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            if (scale > 1)
+            {
+                scale /= 10;
+                ns += (*p - '0') * scale;
+            }
+        }
+        return p == first ? nullptr : p;
+    }
+
+    // "Z", "+HH:MM", "-HH", "+HHMM" or nothing; offset is added to local time to get UTC
+    bool ParseZone(const char* p, const char* end, int64_t& offset)
+    {
+        offset = 0;
+        while (p < end && *p == ' ')
+            p++;
+        if (p == end)
+            return true;
+        if (*p == 'Z' || *p == 'z')
+            return p + 1 == end;
+        if (*p != '+' && *p != '-')
+            return false;
+        const int64_t sign = *p == '-' ? 1 : -1;
+        p++;
+        int digits[4];
+        int count = 0;
+        for (; p < end && count < 4; p++)
+        {
+            if (*p >= '0' && *p <= '9')
+                digits[count++] = *p - '0';
+            else if (*p != ':' || count != 2)
+                return false;
+        }
+        if (p != end || (count != 2 && count != 4))
+            return false;
+        const int64_t minutes = (digits[0] * 10 + digits[1]) * 60 + (count == 4 ? digits[2] * 10 + digits[3] : 0);
+        offset = sign * minutes * 60 * NsPerSecond;
+        return true;
+    }
+
+    bool ValidTime(unsigned h, unsigned m, unsigned s)
+    {
+        return h < 24 && m < 60 && s < 61; // 60 for leap seconds
+    }
+
+    bool ValidDate(int64_t y, unsigned m, unsigned d)
+    {
+        return y > 0 && m >= 1 && m <= 12 && d >= 1 && d <= 31;
+    }
+
+    // "YYYY-MM-DD", "YYYY-MM-DD?HH:MM:SS[.f][zone]" and "HH:MM:SS[.f]" with zero-padded fields
+    bool ParseFixed(const char* p, const char* end, int64_t& ns)
+    {
+        const size_t length = end - p;
+        if (length >= 8 && p[2] == ':' && p[5] == ':')
+        {
+            const uint64_t v = Load8(p); // "HH:MM:SS"
+            if (!AllDigits(v, 0xFFFF00FFFF00FFFFull))
+                return false;
+            const unsigned h = Two(v, 0), m = Two(v, 3), s = Two(v, 6);
+            int64_t fraction;
+            const char* rest = ParseFraction(p + 8, end, fraction);
+            if (!ValidTime(h, m, s) || rest != end)
+                return false;
+            ns = ((h * 60 + m) * 60 + s) * NsPerSecond + fraction;
+            return true;
+        }
+
+        if (length < 10 || p[4] != '-' || p[7] != '-')
+            return false;
+        const uint64_t date = Load8(p); // "YYYY-MM-"
+        if (!AllDigits(date, 0x00FFFF00FFFFFFFFull) || p[8] < '0' || p[8] > '9' || p[9] < '0' || p[9] > '9')
+            return false;
+        const int64_t y = Two(date, 0) * 100 + Two(date, 2);
+        const unsigned mo = Two(date, 5);
+        const unsigned d = (p[8] - '0') * 10 + (p[9] - '0');
+        if (!ValidDate(y, mo, d))
+            return false;
+        int64_t result = DaysFromCivil(y, mo, d) * 86400 * NsPerSecond;
+        if (length == 10)
+        {
+            ns = result;
+            return true;
+        }
+
+        if (length < 19 || (p[10] != 'T' && p[10] != ' ') || p[13] != ':' || p[16] != ':')
+            return false;
+        const uint64_t time = Load8(p + 11); // "HH:MM:SS"
+        if (!AllDigits(time, 0xFFFF00FFFF00FFFFull))
+            return false;
+        const unsigned h = Two(time, 0), m = Two(time, 3), s = Two(time, 6);
+        int64_t fraction, offset;
+        const char* rest = ParseFraction(p + 19, end, fraction);
+        if (!ValidTime(h, m, s) || !rest || !ParseZone(rest, end, offset))
+            return false;
+        ns = result + ((h * 60 + m) * 60 + s) * NsPerSecond + fraction + offset;
+        return true;
+    }
+
+    // Irregular layouts: a date "Y?M?D" with any of - / . as separators and a time "H:M[:S[.f]]", each
+    // field one or more digits.
+    bool ParseGeneral(const char* p, const char* end, int64_t& ns)
+    {
+        auto number = [&](int64_t& value, int maxDigits) {
+            const char* first = p;
+            value = 0;
+            for (; p < end && *p >= '0' && *p <= '9' && p - first < maxDigits; p++)
+                value = value * 10 + (*p - '0');
+            return p > first;
+        };
+
+        int64_t result = 0;
+        int64_t a;
+        if (!number(a, 4))
+            return false;
+        if (p < end && (*p == '-' || *p == '/' || *p == '.'))
+        {
+            const char separator = *p++;
+            int64_t m, d;
+            if (!number(m, 2) || p == end || *p++ != separator || !number(d, 2) || !ValidDate(a, static_cast<unsigned>(m), static_cast<unsigned>(d)))
+                return false;
+            result = DaysFromCivil(a, static_cast<unsigned>(m), static_cast<unsigned>(d)) * 86400 * NsPerSecond;
+            if (p == end)
+            {
+                ns = result;
+                return true;
+            }
+            if (*p != 'T' && *p != ' ')
+                return false;
+            while (p < end && (*p == 'T' || *p == ' '))
+                p++;
+            if (!number(a, 2))
+                return false;
+        }
+
+        // time of day, a holds the hours
+        int64_t m, s = 0, fraction = 0, offset = 0;
+        if (p == end || *p++ != ':' || !number(m, 2))
+            return false;
+        if (p < end && *p == ':')
+        {
+            p++;
+            if (!number(s, 2))
+                return false;
+            p = ParseFraction(p, end, fraction);
+            if (!p)
+                return false;
+        }
+        if (!ValidTime(static_cast<unsigned>(a), static_cast<unsigned>(m), static_cast<unsigned>(s)) || !ParseZone(p, end, offset))
+            return false;
+        ns = result + ((a * 60 + m) * 60 + s) * NsPerSecond + fraction + offset;
+        return true;
+    }
+}
+
+bool ParseTimestamp(std::string_view str, int64_t& ns)
+{
+    const char* p = str.data();
+    const char* end = p + str.size();
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t'))
+        end--;
+    if (end - p < 4)
+        return false;
+    return ParseFixed(p, end, ns) || ParseGeneral(p, end, ns);
+}
+
+void FormatTimestamp(double seconds, char* buffer, size_t size)
+{
+    const double whole = std::floor(seconds);
+    const int64_t total = static_cast<int64_t>(whole);
+    const unsigned micros = static_cast<unsigned>(std::min(999999.0, std::round((seconds - whole) * 1e6)));
+    const int64_t days = (total >= 0 ? total : total - 86399) / 86400;
+    const unsigned daySeconds = static_cast<unsigned>(total - days * 86400);
+    const unsigned h = daySeconds / 3600, m = daySeconds / 60 % 60, s = daySeconds % 60;
+    if (days == 0)
+    {
+        snprintf(buffer, size, "%02u:%02u:%02u.%06u", h, m, s, micros);
+        return;
+    }
+    int64_t y;
+    unsigned mo, d;
+    CivilFromDays(days, y, mo, d);
+    snprintf(buffer, size, "%04lld-%02u-%02u %02u:%02u:%02u.%06u", static_cast<long long>(y), mo, d, h, m, s, micros);
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Timestamps are parsed to nanoseconds since 1970-01-01 UTC. Accepted formats:
+//   ISO-8601 dates with an optional time: "2024-03-01", "2024-03-01T12:34:56", "2024-03-01 12:34:56.123456789",
+//     optionally followed by "Z" or a "+HH:MM" / "-HH:MM" offset
+//   times of day: "12:34:56", "12:34:56.250", "12:34" (counted from 1970-01-01)
+// The usual zero-padded layouts are checked and converted eight characters at a time; anything else
+// (single-digit fields, '/' or '.' date separators, missing seconds) goes through a slower general scanner.
+bool ParseTimestamp(std::string_view str, int64_t& ns);
+
+// Seconds since the epoch (the unit of ImPlot's time axis) of a parsed timestamp, split so the
+// nanoseconds survive the conversion as far as a double allows.
+inline double TimestampSeconds(int64_t ns)
+{
+	return static_cast<double>(ns / 1000000000) + static_cast<double>(ns % 1000000000) * 1e-9;
+}
+
+// "2024-03-01 12:34:56.123456", or just the time of day for values within the first day
+void FormatTimestamp(double seconds, char* buffer, size_t size);
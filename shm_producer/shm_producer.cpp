@@ -0,0 +1,150 @@
+// Reference producer for the viewer's shared memory input (see SharedSegment.h): sets up the segment and
+// writes sine channels into it at a fixed rate until Ctrl+C or the given time is up.
+//
+//   shm_producer [signals=16] [samples/s=1000000] [seconds=0, until Ctrl+C] [name=Local\plot_with_imgui]
+#include "SharedSegment.h"
+#include "SignalGenerator.h"
+#include <Windows.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+using namespace SharedSegment;
+
+namespace
+{
+    const double RingSeconds = 1.0;	// of samples a viewer can fall behind before it loses some
+    const size_t Batch = 4096;
+
+    std::atomic<bool> g_stop(false);
+
+    BOOL WINAPI OnConsoleCtrl(DWORD)
+    {
+        g_stop = true;
+        return TRUE;
+    }
+
+    void Write(Header* header, size_t channel, const double* values, size_t count)
+    {
+        Channel& target = Channels(header)[channel];
+        const uint64_t end = target.end.load(std::memory_order_relaxed);
+        target.begin.store(end + count, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        double* ring = Ring(header, channel);
+        const size_t capacity = static_cast<size_t>(header->capacity);
+        const size_t at = static_cast<size_t>(end & (capacity - 1));
+        const size_t first = std::min(count, capacity - at);
+        memcpy(ring + at, values, first * sizeof(double));
+        memcpy(ring, values + first, (count - first) * sizeof(double));
+        target.end.store(end + count, std::memory_order_release);
+    }
+
+    void Stamp(Header* header, uint64_t end)
+    {
+        const uint64_t sequence = header->stampSequence.load(std::memory_order_relaxed);
+        header->stampSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->stampEnd.store(end, std::memory_order_relaxed);
+        header->stampTime.store(Now(), std::memory_order_relaxed);
+        header->stampSequence.store(sequence + 2, std::memory_order_release);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t signals = static_cast<uint32_t>(std::max(1, argc > 1 ? atoi(argv[1]) : 16));
+    const double rate = std::min(1e8, std::max(1.0, argc > 2 ? atof(argv[2]) : 1e6)); // as LiveSource allows
+    const double seconds = argc > 3 ? atof(argv[3]) : 0;
+    const char* name = argc > 4 ? argv[4] : DefaultName;
+
+    const uint32_t channels = signals + 1;
+    uint64_t capacity = Batch;
+    while (capacity < rate * RingSeconds)
+        capacity <<= 1;
+    const uint64_t bytes = SegmentBytes(channels, capacity);
+
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32),
+        static_cast<DWORD>(bytes), name);
+    if (!mapping)
+    {
+        fprintf(stderr, "cannot create the segment %s\n", name);
+        return 1;
+    }
+    // a segment still mapped by a viewer is reused, and cannot grow
+    Header* header = static_cast<Header*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<size_t>(bytes)));
+    if (!header)
+    {
+        fprintf(stderr, "the segment %s is in use with a smaller size, close the viewers first\n", name);
+        CloseHandle(mapping);
+        return 1;
+    }
+
+    // viewers of a previous session see the version go away and let go of the segment
+    header->version.store(0, std::memory_order_release);
+    memcpy(header->magic, Magic, sizeof(Magic));
+    header->channels = channels;
+    header->capacity = capacity;
+    header->rate = rate;
+    header->dataOffset = bytes - channels * capacity * sizeof(double);
+    header->bytes = bytes;
+    header->stampSequence.store(0, std::memory_order_relaxed);
+    header->stampEnd.store(0, std::memory_order_relaxed);
+    header->stampTime.store(0, std::memory_order_relaxed);
+    for (uint32_t channel = 0; channel < channels; channel++)
+    {
+        Channel& target = Channels(header)[channel];
+        memset(target.name, 0, sizeof(target.name));
+        snprintf(target.name, sizeof(target.name), channel == 0 ? "time" : "shm %u", channel);
+        target.type = channel == 0 ? 1 : 0; // ColumnType::Time, ColumnType::Number
+        target.begin.store(0, std::memory_order_relaxed);
+        target.end.store(0, std::memory_order_relaxed);
+    }
+    header->session.store(static_cast<uint64_t>(Now()), std::memory_order_relaxed);
+    header->version.store(Version, std::memory_order_release);
+
+    SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+    printf("%s: %u signals at %.0f samples/s, %llu samples per ring\n", name, signals, rate, static_cast<unsigned long long>(capacity));
+
+    std::vector<std::vector<double>> batch(channels, std::vector<double>(Batch));
+    const auto start = std::chrono::steady_clock::now();
+    SignalGenerator generator(channels, rate, std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count());
+    auto report = start;
+    uint64_t produced = 0;
+    uint64_t reported = 0;
+    while (!g_stop)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double>(now - start).count();
+        if (seconds > 0 && elapsed >= seconds)
+            break;
+        if (now - report >= std::chrono::seconds(1))
+        {
+            printf("%.2f MS/s per channel\n", (produced - reported) / std::chrono::duration<double>(now - report).count() / 1e6);
+            report = now;
+            reported = produced;
+        }
+        const uint64_t due = static_cast<uint64_t>(elapsed * rate);
+        if (due <= produced)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(Batch, due - produced));
+
+        generator.Next(batch, count);
+
+        for (uint32_t channel = 0; channel < channels; channel++)
+            Write(header, channel, batch[channel].data(), count);
+        produced += count;
+        Stamp(header, produced);
+    }
+
+    header->version.store(0, std::memory_order_release);
+    UnmapViewOfFile(header);
+    CloseHandle(mapping);
+    return 0;
+}